@@ -0,0 +1,42 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#include "arena.hh"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace mc {
+
+constexpr size_t Arena::CHUNK_SIZE;
+
+void *Arena::allocate(size_t size, size_t align) {
+    assert(align && (align & (align - 1)) == 0);
+    auto p = reinterpret_cast<uintptr_t>(cur);
+    p = (p + align - 1) & ~uintptr_t(align - 1);
+    if (!cur || p + size > reinterpret_cast<uintptr_t>(end)) {
+        // big objects get a chunk of their own
+        size_t len = std::max(CHUNK_SIZE, size + align);
+        cur = static_cast<char *>(::operator new(len));
+        end = cur + len;
+        chunks.push_back(cur);
+        p = reinterpret_cast<uintptr_t>(cur);
+        p = (p + align - 1) & ~uintptr_t(align - 1);
+    }
+    cur = reinterpret_cast<char *>(p + size);
+    used += size;
+    return reinterpret_cast<void *>(p);
+}
+void Arena::release() {
+    for (auto it = dtors.rbegin(); it != dtors.rend(); ++it)
+        it->run(it->obj);
+    dtors.clear();
+    for (auto chunk: chunks)
+        ::operator delete(chunk);
+    chunks.clear();
+    cur = end = nullptr;
+    used = 0;
+}
+
+}
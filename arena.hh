@@ -0,0 +1,55 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#ifndef __MC_ARENA_HH__
+#define __MC_ARENA_HH__
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mc {
+
+/*
+ * Bump allocator for nodes living as long as their owner. Objects are
+ * never freed one by one: release() runs the pending destructors in
+ * reverse order and frees all chunks at once.
+ */
+class Arena {
+public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena() { release(); }
+
+    template<typename T, typename ...Args>
+    T *make(Args &&...args) {
+        auto obj = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value)
+            dtors.push_back({obj, [](void *p) { static_cast<T *>(p)->~T(); }});
+        return obj;
+    }
+    void *allocate(size_t size, size_t align);
+    void release();
+    size_t allocated() const { return used; }
+
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    struct Dtor {
+        void *obj;
+        void (*run)(void *);
+    };
+
+    std::vector<char *> chunks;
+    std::vector<Dtor> dtors;
+    char *cur{nullptr}, *end{nullptr};
+    size_t used{0};
+};
+
+}
+
+#endif //__MC_ARENA_HH__
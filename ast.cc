@@ -3,6 +3,7 @@
 namespace mc {
 
 std::vector<AST *> *global_prog = nullptr;
+Arena ast_arena;
 
 const char *const BinaryExpr::OpStr[] = {",", "=", "==", "!=", "<", ">", "||",
                                          "&&", "+", "-", "*", "/", "%"};
@@ -1,6 +1,7 @@
 #ifndef __MC_AST_HH__
 #define __MC_AST_HH__
 
+#include "arena.hh"
 #include "type.hh"
 #include <iostream>
 #include <string>
@@ -25,6 +26,9 @@ struct RefExpr;
 struct NumExpr;
 using Program = std::vector<AST *>;
 
+// owns the AST nodes, their types and fields
+extern Arena ast_arena;
+
 #define VISITS()                                                                   \
     V(FuncDefn)                                                                \
     V(IfStmt)                                                                  \
@@ -71,15 +75,16 @@ struct AST {
 struct FuncDefn : public AST {
     OVERRIDE()
 
-    FuncDefn(Type *r, std::string n, const std::vector<Field *> &ps,
+    FuncDefn(Type *r, Symbol n, const std::vector<Field *> &ps,
              std::vector<Stmt *> b)
-            : ret_type(r), name(std::move(n)), params(ps),
+            : ret_type(r), sym(n), params(ps),
               body(std::move(b)) {
-        type = new FuncType(r, ps);
+        type = ast_arena.make<FuncType>(r, ps);
     }
 
     Type *get_ret_type() const { return ret_type; }
-    const std::string &get_name() const { return name; }
+    Symbol get_sym() const { return sym; }
+    const std::string &get_name() const { return symbols.name(sym); }
     const std::vector<Field *> &get_params() const { return params; }
     const std::vector<Stmt *> &get_body() const { return body; }
     Type *get_type() const { return type; }
@@ -87,7 +92,7 @@ struct FuncDefn : public AST {
 private:
     Type *type;
     Type *ret_type;
-    std::string name;
+    Symbol sym;
     std::vector<Field *> params;
     std::vector<Stmt *> body;
 };
@@ -148,7 +153,7 @@ private:
 struct DeclStmt : public Stmt {
     OVERRIDE()
 
-    DeclStmt(const std::string &s, Type *t) : var(s, t) {}
+    DeclStmt(Symbol s, Type *t) : var(s, t) {}
     explicit DeclStmt(Field v) : var(std::move(v)) {}
 
     const Field &get_var() const { return var; }
@@ -213,16 +218,17 @@ struct RefExpr : public Expr {
 
     bool isLhsValue() const override { return true; }
 
-    RefExpr(std::string n, std::vector<Expr *> i)
-            : name(std::move(n)), index(std::move(i)), var_type(nullptr) {}
+    RefExpr(Symbol n, std::vector<Expr *> i)
+            : sym(n), index(std::move(i)), var_type(nullptr) {}
 
-    const std::string &get_name() const { return name; }
+    Symbol get_sym() const { return sym; }
+    const std::string &get_name() const { return symbols.name(sym); }
     const std::vector<Expr *> &get_index() const { return index; }
     Type *get_var_type() const { return var_type; }
     void set_var_type(Type *varType) { var_type = varType; }
 
 private:
-    std::string name;
+    Symbol sym;
     std::vector<Expr *> index;
     Type *var_type;
 };
@@ -230,14 +236,15 @@ private:
 struct CallExpr : public Expr {
     OVERRIDE()
 
-    CallExpr(std::string n, std::vector<Expr *> as)
-            : name(std::move(n)), args(std::move(as)) {}
+    CallExpr(Symbol n, std::vector<Expr *> as)
+            : sym(n), args(std::move(as)) {}
 
-    const std::string &get_name() const { return name; }
+    Symbol get_sym() const { return sym; }
+    const std::string &get_name() const { return symbols.name(sym); }
     const std::vector<Expr *> &get_args() const { return args; }
 
 private:
-    std::string name;
+    Symbol sym;
     std::vector<Expr *> args;
 };
 
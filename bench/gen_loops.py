@@ -0,0 +1,27 @@
+#!/usr/bin/env python3
+"""usage: gen_loops.py loops [seed]
+Prints a mini-C main() with 200 locals and the given number of loops,
+each with 4 branches on random locals: a large CFG where liveness has
+200 values to track across every block."""
+import random
+import sys
+
+random.seed(int(sys.argv[2]) if len(sys.argv) > 2 else 1)
+n = int(sys.argv[1])
+V = 200
+out = ["int putint(int x);", "int g[64];", "int main() {"]
+out += ["    int v%d;" % i for i in range(V)]
+out += ["    v%d = %d;" % (i, i) for i in range(V)]
+for k in range(n):
+    a, b, c = random.sample(range(V), 3)
+    out.append("    v%d = 0;" % a)
+    out.append("    while (v%d < %d) {" % (a, random.randint(2, 5)))
+    for _ in range(4):
+        x, y, z = random.sample(range(V), 3)
+        out.append("        if (v%d > v%d) v%d = v%d + v%d; else v%d = v%d - 1;" % (x, y, z, x, y, z, z))
+    out.append("        g[v%d %% 64] = v%d;" % (b, c))
+    out.append("        v%d = v%d + 1;" % (a, a))
+    out.append("    }")
+out.append("    putint(%s);" % " + ".join("v%d" % i for i in range(V)))
+out.append("    return 0;\n}")
+print("\n".join(out))
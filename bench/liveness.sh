@@ -0,0 +1,19 @@
+#!/bin/bash
+# usage: bench/liveness.sh [compiler] [loops...]
+# Compiles gen_loops.py functions of the given sizes (100 300 loops by
+# default) and prints the time of LiveAnalyzer::analyze, as logged to
+# debug.log, and of the whole compile.
+DIR=$(cd "$(dirname "$0")" && pwd)
+CC=$(realpath "${1:-$DIR/../riscv64C}")
+shift
+WORK=$(mktemp -d)
+trap 'rm -rf $WORK' EXIT
+for loops in ${@:-100 300}; do
+    python3 "$DIR/gen_loops.py" $loops > "$WORK/loops$loops.c"
+    lines=$(wc -l < "$WORK/loops$loops.c")
+    start=$(date +%s%N)
+    (cd "$WORK" && "$CC" "loops$loops.c" > /dev/null) || { echo "$loops loops: compile failed"; exit 1; }
+    total=$(( ($(date +%s%N) - start) / 1000000 ))
+    live=$(grep -m1 "^liveness:" "$WORK/debug.log" | cut -d' ' -f2)
+    echo "$loops loops, $lines lines: liveness ${live:-?} ms, compile $total ms"
+done
@@ -12,7 +12,7 @@ namespace mc {
 namespace eyr {
 
 BasicBlock *Function::allocBlock() {
-    auto blk = new BasicBlock(this);
+    auto blk = module->make<BasicBlock>(this);
     blk->f_idx = blocks.size();
     blk->label = module->l_id++;
     blocks.push_back(blk);
@@ -25,7 +25,7 @@ Variable *Function::allocLocalVar(bool temp, int width, bool addr) {
         var_name = std::string("t") + std::to_string(module->t_id++);
     else
         var_name = std::string("T") + std::to_string(module->T_id++);
-    auto var = new Variable(this, std::move(var_name), temp, width, addr);
+    auto var = module->make<Variable>(this, std::move(var_name), temp, width, addr);
     local_vars.push_back(var);
     return var;
 }
@@ -34,7 +34,7 @@ Function::Function(Module *m, std::string n, int argc) :
         module(m), name(std::move(n)), params(argc) {
     entry = allocBlock();
     for (int i = 0; i < argc; ++i)
-        params[i] = new Variable(this, std::string("p") + std::to_string(i), false);
+        params[i] = module->make<Variable>(this, std::string("p") + std::to_string(i), false);
 }
 
 std::ostream &Function::print(std::ostream &os) const {
@@ -62,6 +62,19 @@ void Function::arrangeBlock() {
         if (blk->jump_out)
             que.push_back(blk->jump_out);
     }
+    for (auto b: blocks) {
+        if (!b->reachable)
+            continue;
+        for (auto inst: b->insts) {
+            auto phi = dyn_cast<PhiInst>(inst);
+            if (!phi)
+                break;
+            for (auto inb: b->inBlocks()) {
+                if (!inb->reachable)
+                    phi->removeSrc(inb);
+            }
+        }
+    }
     for (auto b: blocks) {
         if (!b->reachable) {
             b->safeRemove();
@@ -89,10 +102,7 @@ void Function::arrangeBlock() {
             break;
         blk = *left.begin();
     }
-    for (auto b: blocks) {
-        if (!b->reachable)
-            delete (b);
-    }
+    // unreachable blocks are dropped, the module arena frees them
     blocks = tmp_blocks;
 
     int f_bid = 0;
@@ -107,8 +117,7 @@ void Module::addFunction(Function *f) {
 }
 
 Variable *Module::allocGlobalVar(int width, bool addr) {
-    auto var = new
-            Variable(nullptr, std::string("T") + std::to_string(T_id++), false, width, addr);
+    auto var = make<Variable>(nullptr, std::string("T") + std::to_string(T_id++), false, width, addr);
     global_vars.push_back(var);
     global_items.push_back(var);
     return var;
@@ -161,38 +170,31 @@ std::vector<BasicBlock *> BasicBlock::inBlocks() const {
     return res;
 }
 void BasicBlock::addInst(Instruction *i) {
-    i->link = insts.insert(insts.end(), i);
+    insts.push_back(i);
     i->block = this;
 }
 void BasicBlock::removeInst(Instruction *i) {
     assert(i->block == this);
-    insts.erase(i->link);
+    insts.erase(i);
     i->block = nullptr;
 }
 Instruction *BasicBlock::prevInstOf(Instruction *i) {
     assert(i->block == this);
-    auto it = i->link;
-    if (it != insts.begin())
-        return *(--it);
-    return nullptr;
+    return i->ilist_prev;
 }
 Instruction *BasicBlock::nextInstOf(Instruction *i) {
     assert(i->block == this);
-    auto it = i->link;
-    if (++it != insts.end())
-        return *it;
-    return nullptr;
+    return i->ilist_next;
 }
 void BasicBlock::addInstAfter(Instruction *pos, Instruction *i) {
     assert(pos->block == this);
     i->block = this;
-    auto it = pos->link;
-    i->link = insts.insert(++it, i);
+    insts.insert(pos->ilist_next, i);
 }
 void BasicBlock::addInstBefore(Instruction *pos, Instruction *i) {
     assert(pos->block == this);
     i->block = this;
-    i->link = insts.insert(pos->link, i);
+    insts.insert(pos, i);
 }
 
 std::ostream &Variable::print(std::ostream &os) const {
@@ -265,6 +267,7 @@ std::ostream &StoreInst::print(std::ostream &os) const {
 }
 std::vector<Variable *> StoreInst::uses() const {
     auto res = Instruction::uses();
+    res.push_back(base);
     if (!src.imm)
         res.push_back(src.var);
     if (!idx.imm)
@@ -289,7 +292,12 @@ std::ostream &JumpInst::print(std::ostream &os) const {
 
 std::ostream &BranchInst::print(std::ostream &os) const {
     os << "\t" << "if ";
-    os << lhs << ' ' << BinaryExpr::OpStr[static_cast<int>(opt)] << ' ' << rhs;
+    os << lhs << ' ';
+    if (opt == LgcOp::GE || opt == LgcOp::LE)
+        os << (opt == LgcOp::GE ? ">=" : "<=");
+    else
+        os << BinaryExpr::OpStr[static_cast<int>(opt)];
+    os << ' ' << rhs;
     os << " goto l" << dst->label << std::endl;
     return os;
 }
@@ -312,6 +320,76 @@ std::vector<Variable *> ReturnInst::uses() const {
     return {};
 }
 
+std::ostream &PhiInst::print(std::ostream &os) const {
+    os << '\t' << dst->name << " = phi(";
+    for (size_t i = 0; i < srcs.size(); ++i)
+        os << (i ? ", l" : "l") << srcs[i].first->label << ": " << srcs[i].second;
+    os << ')' << std::endl;
+    return os;
+}
+std::vector<Variable *> PhiInst::uses() const {
+    std::vector<Variable *> res;
+    for (auto &src: srcs) {
+        if (!src.second.imm)
+            res.push_back(src.second.var);
+    }
+    return res;
+}
+Operand &PhiInst::srcOf(BasicBlock *pred) {
+    for (auto &src: srcs) {
+        if (src.first == pred)
+            return src.second;
+    }
+    assert(false);
+    return srcs.front().second;
+}
+void PhiInst::removeSrc(BasicBlock *pred) {
+    for (auto it = srcs.begin(); it != srcs.end(); ++it) {
+        if (it->first == pred) {
+            srcs.erase(it);
+            return;
+        }
+    }
+}
+
+static inline void replaceOpr(Operand &opr, Variable *from, Operand to) {
+    if (!opr.imm && opr.var == from)
+        opr = to;
+}
+void BinaryInst::replaceUse(Variable *from, Operand to) {
+    replaceOpr(lhs, from, to), replaceOpr(rhs, from, to);
+}
+void UnaryInst::replaceUse(Variable *from, Operand to) {
+    replaceOpr(opr, from, to);
+}
+void CallInst::replaceUse(Variable *from, Operand to) {
+    for (auto &arg: args)
+        replaceOpr(arg, from, to);
+}
+void MoveInst::replaceUse(Variable *from, Operand to) {
+    replaceOpr(src, from, to);
+}
+void StoreInst::replaceUse(Variable *from, Operand to) {
+    if (base == from && !to.imm)
+        base = to.var;
+    replaceOpr(idx, from, to), replaceOpr(src, from, to);
+}
+void LoadInst::replaceUse(Variable *from, Operand to) {
+    if (src == from && !to.imm)
+        src = to.var;
+    replaceOpr(idx, from, to);
+}
+void BranchInst::replaceUse(Variable *from, Operand to) {
+    replaceOpr(lhs, from, to), replaceOpr(rhs, from, to);
+}
+void ReturnInst::replaceUse(Variable *from, Operand to) {
+    replaceOpr(opr, from, to);
+}
+void PhiInst::replaceUse(Variable *from, Operand to) {
+    for (auto &src: srcs)
+        replaceOpr(src.second, from, to);
+}
+
 std::vector<Variable *> AssignInst::defs() const {
     return {dst};
 }
@@ -11,6 +11,8 @@
 #include <cassert>
 #include <iostream>
 #include <list>
+#include "arena.hh"
+#include "ilist.hh"
 #include "util.hh"
 
 namespace mc {
@@ -31,6 +33,7 @@ struct CallInst;
 struct JumpInst;
 struct BranchInst;
 struct ReturnInst;
+struct PhiInst;
 
 struct Module {
     std::vector<Item *> global_items;
@@ -39,7 +42,10 @@ struct Module {
     int T_id{0};
     int t_id{0};
     int l_id{0};
+    Arena arena; // owns the functions, blocks, variables and instructions
 
+    template<typename T, typename ...Args>
+    T *make(Args &&...args) { return arena.make<T>(std::forward<Args>(args)...); }
     void addFunction(Function *f);
     Variable *allocGlobalVar(int width = 0, bool addr = false);
     friend std::ostream &operator<<(std::ostream &os, const Module &mod);
@@ -75,7 +81,7 @@ struct BasicBlock : public Item {
     int label{0}; // global label
     int f_idx{0}; // in-function idx
     bool reachable{true};
-    std::list<Instruction *> insts;
+    IList<Instruction> insts;
 
     BasicBlock *fall_out{nullptr};
     BasicBlock *fall_in{nullptr};
@@ -147,12 +153,20 @@ struct Operand {
     }
 };
 
-struct Instruction : public Item {
+struct Instruction : public Item, public IListNode<Instruction> {
+    enum class Kind {
+        BINARY, UNARY, CALL, MOVE, LOAD, PHI, // AssignInst
+        STORE, JUMP, BRANCH, RETURN,
+    };
+    const Kind kind;
     BasicBlock *block{nullptr};
-    std::list<Instruction *>::iterator link;
+
+    explicit Instruction(Kind k) : kind(k) {}
 
     virtual std::vector<Variable *> uses() const { return {}; }
     virtual std::vector<Variable *> defs() const { return {}; }
+    // replace the uses of "from" with "to", array bases only with variables
+    virtual void replaceUse(Variable *from, Operand to) {}
 
     inline Instruction *addAfter(Instruction *i) {
         return assert(block), block->addInstAfter(this, i), i;
@@ -168,8 +182,9 @@ struct Instruction : public Item {
 struct AssignInst : public Instruction {
     Variable *dst;
 
-    explicit AssignInst(Variable *d) : dst(d) {}
+    AssignInst(Kind k, Variable *d) : Instruction(k), dst(d) {}
     std::vector<Variable *> defs() const override;
+    static bool classof(const Instruction *i) { return i->kind <= Kind::PHI; }
 };
 
 struct BinaryInst : public AssignInst {
@@ -180,10 +195,12 @@ struct BinaryInst : public AssignInst {
     Operand lhs, rhs;
 
     BinaryInst(Variable *d, BinOp op, Operand l, Operand r) :
-            AssignInst(d), opt(op), lhs(l), rhs(r) {}
+            AssignInst(Kind::BINARY, d), opt(op), lhs(l), rhs(r) {}
 
     std::vector<Variable *> uses() const override;
+    void replaceUse(Variable *from, Operand to) override;
     std::ostream &print(std::ostream &os) const override;
+    static bool classof(const Instruction *i) { return i->kind == Kind::BINARY; }
 };
 
 struct UnaryInst : public AssignInst {
@@ -194,27 +211,34 @@ struct UnaryInst : public AssignInst {
     Operand opr;
 
     UnaryInst(Variable *d, UnOp op, Operand o) :
-            AssignInst(d), opt(op), opr(o) {}
+            AssignInst(Kind::UNARY, d), opt(op), opr(o) {}
     std::vector<Variable *> uses() const override;
+    void replaceUse(Variable *from, Operand to) override;
     std::ostream &print(std::ostream &os) const override;
+    static bool classof(const Instruction *i) { return i->kind == Kind::UNARY; }
 };
 
 struct CallInst : public AssignInst {
     std::string name;
     std::vector<Operand> args;
+    bool tail{false}; // immediately followed by the return of dst, which is then not emitted
 
     CallInst(Variable *d, std::string n, std::vector<Operand> a) :
-            AssignInst(d), name(std::move(n)), args(std::move(a)) {}
+            AssignInst(Kind::CALL, d), name(std::move(n)), args(std::move(a)) {}
     std::vector<Variable *> uses() const override;
+    void replaceUse(Variable *from, Operand to) override;
     std::ostream &print(std::ostream &os) const override;
+    static bool classof(const Instruction *i) { return i->kind == Kind::CALL; }
 };
 
 struct MoveInst : public AssignInst {
     Operand src;
 
-    MoveInst(Variable *d, Operand s) : AssignInst(d), src(s) {}
+    MoveInst(Variable *d, Operand s) : AssignInst(Kind::MOVE, d), src(s) {}
     std::vector<Variable *> uses() const override;
+    void replaceUse(Variable *from, Operand to) override;
     std::ostream &print(std::ostream &os) const override;
+    static bool classof(const Instruction *i) { return i->kind == Kind::MOVE; }
 };
 
 struct StoreInst : public Instruction {
@@ -223,9 +247,11 @@ struct StoreInst : public Instruction {
     Operand src;
 
     StoreInst(Variable *bs, Operand i, Operand s) :
-            base(bs), idx(i), src(s) {}
+            Instruction(Kind::STORE), base(bs), idx(i), src(s) {}
     std::vector<Variable *> uses() const override;
+    void replaceUse(Variable *from, Operand to) override;
     std::ostream &print(std::ostream &os) const override;
+    static bool classof(const Instruction *i) { return i->kind == Kind::STORE; }
 };
 
 struct LoadInst : public AssignInst {
@@ -233,39 +259,113 @@ struct LoadInst : public AssignInst {
     Operand idx;
 
     LoadInst(Variable *d, Variable *s, Operand i) :
-            AssignInst(d), src(s), idx(i) {}
+            AssignInst(Kind::LOAD, d), src(s), idx(i) {}
     std::vector<Variable *> uses() const override;
+    void replaceUse(Variable *from, Operand to) override;
     std::ostream &print(std::ostream &os) const override;
+    static bool classof(const Instruction *i) { return i->kind == Kind::LOAD; }
 };
 
 struct JumpInst : public Instruction {
     BasicBlock *dst;
 
-    explicit JumpInst(BasicBlock *d) : dst(d) {}
+    explicit JumpInst(BasicBlock *d) : Instruction(Kind::JUMP), dst(d) {}
     std::ostream &print(std::ostream &os) const override;
+    static bool classof(const Instruction *i) { return i->kind == Kind::JUMP || i->kind == Kind::BRANCH; }
+
+protected:
+    JumpInst(Kind k, BasicBlock *d) : Instruction(k), dst(d) {}
 };
 
 struct BranchInst : public JumpInst {
     enum class LgcOp {
         EQ = 2, NE, LT, GT, OR, AND,
+        GE, LE, // only produced by branch fusion
     };
     LgcOp opt;
     Operand lhs, rhs;
 
     BranchInst(BasicBlock *d, LgcOp op, Operand l, Operand r) :
-            JumpInst(d), opt(op), lhs(l), rhs(r) {}
+            JumpInst(Kind::BRANCH, d), opt(op), lhs(l), rhs(r) {}
     std::vector<Variable *> uses() const override;
+    void replaceUse(Variable *from, Operand to) override;
     std::ostream &print(std::ostream &os) const override;
+    static bool classof(const Instruction *i) { return i->kind == Kind::BRANCH; }
 };
 
 struct ReturnInst : public Instruction {
     Operand opr;
 
-    explicit ReturnInst(Operand o) : opr(o) {}
+    explicit ReturnInst(Operand o) : Instruction(Kind::RETURN), opr(o) {}
+    std::vector<Variable *> uses() const override;
+    void replaceUse(Variable *from, Operand to) override;
+    std::ostream &print(std::ostream &os) const override;
+    static bool classof(const Instruction *i) { return i->kind == Kind::RETURN; }
+};
+
+// only exists while the function is in SSA form, always at the beginning of a block
+struct PhiInst : public AssignInst {
+    std::vector<std::pair<BasicBlock *, Operand>> srcs; // one per predecessor
+
+    explicit PhiInst(Variable *d) : AssignInst(Kind::PHI, d) {}
+    Operand &srcOf(BasicBlock *pred);
+    void removeSrc(BasicBlock *pred);
     std::vector<Variable *> uses() const override;
+    void replaceUse(Variable *from, Operand to) override;
     std::ostream &print(std::ostream &os) const override;
+    static bool classof(const Instruction *i) { return i->kind == Kind::PHI; }
+};
+
+/*
+ * Switch dispatch on Instruction::kind, without RTTI. Derived defines
+ * visitXxxInst for the kinds it handles, the others fall back to the
+ * base class: BranchInst to JumpInst, the assignments to AssignInst,
+ * everything at last to visitInstruction, which by default fails.
+ */
+template<typename Derived, typename Ret = void>
+struct InstVisitor {
+#define DISPATCH(k, type) case Instruction::Kind::k: return self()->visit##type(static_cast<type *>(ins));
+    Ret visit(Instruction *ins) {
+        switch (ins->kind) {
+            DISPATCH(BINARY, BinaryInst)
+            DISPATCH(UNARY, UnaryInst)
+            DISPATCH(CALL, CallInst)
+            DISPATCH(MOVE, MoveInst)
+            DISPATCH(LOAD, LoadInst)
+            DISPATCH(PHI, PhiInst)
+            DISPATCH(STORE, StoreInst)
+            DISPATCH(JUMP, JumpInst)
+            DISPATCH(BRANCH, BranchInst)
+            DISPATCH(RETURN, ReturnInst)
+        }
+        assert(false);
+        return Ret();
+    }
+#undef DISPATCH
+
+    Ret visitBinaryInst(BinaryInst *ins) { return self()->visitAssignInst(ins); }
+    Ret visitUnaryInst(UnaryInst *ins) { return self()->visitAssignInst(ins); }
+    Ret visitCallInst(CallInst *ins) { return self()->visitAssignInst(ins); }
+    Ret visitMoveInst(MoveInst *ins) { return self()->visitAssignInst(ins); }
+    Ret visitLoadInst(LoadInst *ins) { return self()->visitAssignInst(ins); }
+    Ret visitPhiInst(PhiInst *ins) { return self()->visitAssignInst(ins); }
+    Ret visitStoreInst(StoreInst *ins) { return self()->visitInstruction(ins); }
+    Ret visitBranchInst(BranchInst *ins) { return self()->visitJumpInst(ins); }
+    Ret visitJumpInst(JumpInst *ins) { return self()->visitInstruction(ins); }
+    Ret visitReturnInst(ReturnInst *ins) { return self()->visitInstruction(ins); }
+    Ret visitAssignInst(AssignInst *ins) { return self()->visitInstruction(ins); }
+    Ret visitInstruction(Instruction *ins) { return assert(false), Ret(); }
+
+private:
+    Derived *self() { return static_cast<Derived *>(this); }
 };
 
+// Checked casts on Instruction::kind in place of dynamic_cast, null gives null.
+template<typename T>
+inline bool isa(const Instruction *ins) { return ins && T::classof(ins); }
+template<typename T>
+inline T *dyn_cast(Instruction *ins) { return isa<T>(ins) ? static_cast<T *>(ins) : nullptr; }
+
 }
 }
 
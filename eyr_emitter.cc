@@ -13,11 +13,11 @@ static inline bool isLogicOp(BinaryExpr::BinOp op) {
 }
 
 void EyrEmitter::visit(FuncDefn *ast) {
-    auto func = new Function(module, ast->get_name(), ast->get_params().size());
+    auto func = module->make<Function>(module, ast->get_name(), ast->get_params().size());
     module->addFunction(func);
     enter_scope();
     for (size_t i = 0; i < func->params.size(); ++i)
-        def(ast->get_params()[i]->id, func->params[i]);
+        def(ast->get_params()[i]->sym, func->params[i]);
     cur_func = func;
     cur_blk = func->entry;
     for (auto s : ast->get_body())
@@ -32,17 +32,12 @@ void EyrEmitter::visit(IfStmt *ast) {
     auto else_blk = cur_func->allocBlock();
     auto merge_blk = cur_func->allocBlock();
 
-    ast->get_cond()->accept(*this);
-    auto pred = cur_opr;
-    cur_blk->addInst(new BranchInst(then_blk, BranchInst::LgcOp::NE, pred, Operand(0)));
-
-    cur_blk->fall(else_blk);
-    cur_blk->jump(then_blk);
+    emitCond(ast->get_cond(), then_blk, else_blk, else_blk);
 
     cur_blk = else_blk;
     if (ast->get_alter())
         ast->get_alter()->accept(*this);
-    cur_blk->addInst(new JumpInst(merge_blk));
+    cur_blk->addInst(module->make<JumpInst>(merge_blk));
     cur_blk->jump(merge_blk);
 
     cur_blk = then_blk;
@@ -57,15 +52,11 @@ void EyrEmitter::visit(WhileStmt *ast) {
     auto test_blk = cur_func->allocBlock();
     auto break_blk = cur_func->allocBlock();
 
-    cur_blk->addInst(new JumpInst(test_blk));
+    cur_blk->addInst(module->make<JumpInst>(test_blk));
     cur_blk->jump(test_blk);
 
     cur_blk = test_blk;
-    ast->get_test()->accept(*this);
-    auto pred = cur_opr;
-    cur_blk->addInst(new BranchInst(loop_blk, BranchInst::LgcOp::NE, pred, Operand(0)));
-    cur_blk->jump(loop_blk);
-    cur_blk->fall(break_blk);
+    emitCond(ast->get_test(), loop_blk, break_blk, break_blk);
 
     cur_blk = loop_blk;
     if (ast->get_loop())
@@ -74,9 +65,36 @@ void EyrEmitter::visit(WhileStmt *ast) {
 
     cur_blk = break_blk;
 }
+void EyrEmitter::emitCond(Expr *cond, BasicBlock *t_blk, BasicBlock *f_blk, BasicBlock *fall_blk) {
+    auto bin = dynamic_cast<BinaryExpr *>(cond);
+    auto un = dynamic_cast<UnaryExpr *>(cond);
+    if (bin && (bin->get_opt() == BinaryExpr::BinOp::AND || bin->get_opt() == BinaryExpr::BinOp::OR)) {
+        // the rhs is only evaluated when the lhs does not decide
+        auto rhs_blk = cur_func->allocBlock();
+        if (bin->get_opt() == BinaryExpr::BinOp::AND)
+            emitCond(bin->get_lhs(), rhs_blk, f_blk, rhs_blk);
+        else
+            emitCond(bin->get_lhs(), t_blk, rhs_blk, rhs_blk);
+        cur_blk = rhs_blk;
+        emitCond(bin->get_rhs(), t_blk, f_blk, fall_blk);
+    } else if (un && un->get_opt() == UnaryExpr::UnOp::NOT) {
+        emitCond(un->get_opr(), f_blk, t_blk, fall_blk);
+    } else {
+        cond->accept(*this);
+        auto pred = cur_opr;
+        if (fall_blk == f_blk) {
+            cur_blk->addInst(module->make<BranchInst>(t_blk, BranchInst::LgcOp::NE, pred, Operand(0)));
+            cur_blk->jump(t_blk);
+        } else {
+            cur_blk->addInst(module->make<BranchInst>(f_blk, BranchInst::LgcOp::EQ, pred, Operand(0)));
+            cur_blk->jump(f_blk);
+        }
+        cur_blk->fall(fall_blk);
+    }
+}
 void EyrEmitter::visit(ReturnStmt *ast) {
     ast->get_value()->accept(*this);
-    cur_blk->addInst(new ReturnInst(cur_opr));
+    cur_blk->addInst(module->make<ReturnInst>(cur_opr));
     cur_blk = cur_func->allocBlock();
 }
 void EyrEmitter::visit(BlockStmt *ast) {
@@ -93,9 +111,9 @@ void EyrEmitter::visit(DeclStmt *ast) {
     int width = dynamic_cast<ArrayType *>(type) ? type->byteSize() : -1;
     bool constant = dynamic_cast<VariantArrayType *>(type) != nullptr;
     if (cur_func) {
-        def(ast->get_var().id, cur_func->allocLocalVar(false, width, constant));
+        def(ast->get_var().sym, cur_func->allocLocalVar(false, width, constant));
     } else {
-        def(ast->get_var().id, module->allocGlobalVar(width, constant));
+        def(ast->get_var().sym, module->allocGlobalVar(width, constant));
     }
 }
 
@@ -119,7 +137,7 @@ void EyrEmitter::visit(BinaryExpr *ast) {
             auto rhs = cur_opr;
             auto tmp = allocTemp();
             cur_blk->addInst(
-                    new BinaryInst(tmp, static_cast<BinaryInst::BinOp>(ast->get_opt()), lhs, rhs));
+                    module->make<BinaryInst>(tmp, static_cast<BinaryInst::BinOp>(ast->get_opt()), lhs, rhs));
             cur_opr = Operand(tmp);
             break;
         }
@@ -128,7 +146,7 @@ void EyrEmitter::visit(BinaryExpr *ast) {
 void EyrEmitter::visit(UnaryExpr *ast) {
     ast->get_opr()->accept(*this);
     auto tmp_var = allocTemp();
-    cur_blk->addInst(new UnaryInst(tmp_var, static_cast<UnaryInst::UnOp>(ast->get_opt()), cur_opr));
+    cur_blk->addInst(module->make<UnaryInst>(tmp_var, static_cast<UnaryInst::UnOp>(ast->get_opt()), cur_opr));
     cur_opr = Operand(tmp_var);
 }
 void EyrEmitter::visit(RefExpr *ast) {
@@ -140,33 +158,33 @@ void EyrEmitter::visit(RefExpr *ast) {
         auto base = static_cast<Type *>(arr);
         auto idx_var = allocTemp();
         auto tmp_off = allocTemp();
-        cur_blk->addInst(new MoveInst(idx_var, Operand(0)));
+        cur_blk->addInst(module->make<MoveInst>(idx_var, Operand(0)));
         for (auto e : ast->get_index()) {
             base = dynamic_cast<VariantArrayType *>(base)->getBase();
             assert(base != nullptr);
             e->accept(*this);
             auto ret = cur_opr;
-            cur_blk->addInst(new BinaryInst(tmp_off, BinaryInst::BinOp::MUL, ret,
+            cur_blk->addInst(module->make<BinaryInst>(tmp_off, BinaryInst::BinOp::MUL, ret,
                                             Operand(base->byteSize())));
-            cur_blk->addInst(new BinaryInst(idx_var, BinaryInst::BinOp::ADD, Operand(idx_var),
+            cur_blk->addInst(module->make<BinaryInst>(idx_var, BinaryInst::BinOp::ADD, Operand(idx_var),
                                             Operand(tmp_off)));
         }
         if (store) {
-            auto dst = lookup(ast->get_name());
-            cur_blk->addInst(new StoreInst(dst, Operand(idx_var), src));
+            auto dst = lookup(ast->get_sym());
+            cur_blk->addInst(module->make<StoreInst>(dst, Operand(idx_var), src));
             cur_opr = Operand(dst);
         } else {
-            auto mem = lookup(ast->get_name());
-            cur_blk->addInst(new LoadInst(tmp_off, mem, Operand(idx_var)));
+            auto mem = lookup(ast->get_sym());
+            cur_blk->addInst(module->make<LoadInst>(tmp_off, mem, Operand(idx_var)));
             cur_opr = Operand(tmp_off);
         }
     } else {
         if (store) {
-            auto dst = lookup(ast->get_name());
-            cur_blk->addInst(new MoveInst(dst, src));
+            auto dst = lookup(ast->get_sym());
+            cur_blk->addInst(module->make<MoveInst>(dst, src));
             cur_opr = Operand(dst);
         } else {
-            cur_opr = Operand(lookup(ast->get_name()));
+            cur_opr = Operand(lookup(ast->get_sym()));
         }
     }
 }
@@ -178,12 +196,12 @@ void EyrEmitter::visit(CallExpr *ast) {
             args.push_back(cur_opr);
         } else {
             auto tmp_var = allocTemp();
-            cur_blk->addInst(new MoveInst(tmp_var, cur_opr));
+            cur_blk->addInst(module->make<MoveInst>(tmp_var, cur_opr));
             args.emplace_back(tmp_var);
         }
     }
     auto ret_var = allocTemp(); // always temp
-    cur_blk->addInst(new CallInst(ret_var, ast->get_name(), args));
+    cur_blk->addInst(module->make<CallInst>(ret_var, ast->get_name(), args));
     cur_opr = Operand(ret_var);
 }
 void EyrEmitter::visit(NumExpr *ast) {
@@ -201,16 +219,9 @@ Module *EyrEmitter::emit(const Program &prog) {
     leave_scope();
     return module;
 }
-Variable *EyrEmitter::lookup(const std::string &id) {
-    for (auto &e:environ) {
-        auto it = e.find(id);
-        if (it != e.end())
-            return it->second;
-    }
-    return nullptr;
-}
-void EyrEmitter::def(const std::string &id, Variable *var) {
-    environ.begin()->insert({id, var});
+void EyrEmitter::def(Symbol sym, Variable *var) {
+    if (!environ.lookupLocal(sym))
+        environ.bind(sym, var);
 }
 
 };
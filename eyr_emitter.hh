@@ -7,8 +7,7 @@
 
 #include "ast.hh"
 #include "eyr.hh"
-#include <map>
-#include <list>
+#include "symbol.hh"
 
 namespace mc {
 namespace eyr {
@@ -20,13 +19,15 @@ struct EyrEmitter : public ASTVisitor {
 public:
     Module *emit(const Program &prog);
 private:
-    Variable *lookup(const std::string &id);
-    void def(const std::string &id, Variable *var);
-    inline void enter_scope() { environ.emplace_front(); }
-    inline void leave_scope() { environ.pop_front(); }
+    inline Variable *lookup(Symbol sym) const { return environ.lookup(sym); }
+    void def(Symbol sym, Variable *var);
+    // branches to t_blk or f_blk, falling into fall_blk (one of them, no fall_in yet)
+    void emitCond(Expr *cond, BasicBlock *t_blk, BasicBlock *f_blk, BasicBlock *fall_blk);
+    inline void enter_scope() { environ.enter(); }
+    inline void leave_scope() { environ.leave(); }
     inline Variable *allocTemp() { return cur_func->allocLocalVar(); }
 
-    std::list<std::map<std::string, Variable *>> environ;
+    ScopeTable<Variable *> environ;
 
     BasicBlock *cur_blk;
     Function *cur_func;
@@ -3,231 +3,1169 @@
 //
 
 #include "eyr_optimizer.hh"
+#include "eyr_ssa.hh"
+#include <algorithm>
+#include <climits>
 
 namespace mc {
 namespace eyr {
 
-bool EyrOptimizer::ConstFolder::optimize(Module *mod) {
-    flow_changed = false;
+// instructions a callee may have to always be inlined, or when it is called once
+static const int INLINE_SIZE = 40;
+static const int INLINE_ONCE_SIZE = 200;
+// callers stop growing beyond this
+static const int MAX_CALLER_SIZE = 2000;
+
+void EyrOptimizer::Inliner::optimize(Module *mod) {
+    cur_mod = mod;
+    funcs.clear(), callees.clear();
+    sizes.clear(), call_sites.clear();
+    for (auto fun: mod->global_funcs)
+        funcs[fun->name] = fun;
+    for (auto fun: mod->global_funcs) {
+        for (auto blk: fun->blocks) {
+            for (auto ins: blk->insts) {
+                ++sizes[fun];
+                auto call = dyn_cast<CallInst>(ins);
+                if (call && funcs.count(call->name)) {
+                    callees[fun].insert(funcs[call->name]);
+                    ++call_sites[funcs[call->name]];
+                }
+            }
+        }
+    }
+
+    // callees come first in the source, so they are already expanded when inlined
+    for (auto fun: mod->global_funcs) {
+        std::vector<CallInst *> calls;
+        for (auto blk: fun->blocks) {
+            for (auto ins: blk->insts) {
+                if (auto call = dyn_cast<CallInst>(ins))
+                    calls.push_back(call);
+            }
+        }
+        bool changed = false;
+        for (auto call: calls) {
+            auto it = funcs.find(call->name);
+            if (it == funcs.end() || !shouldInline(fun, it->second))
+                continue;
+            sizes[fun] += sizes[it->second];
+            inlineCall(call, it->second);
+            changed = true;
+        }
+        if (changed)
+            fun->arrangeBlock();
+    }
+}
+// the return right after call of its result, if any; nullptr for arguments living in the frame
+ReturnInst *EyrOptimizer::TailCalls::returnOf(CallInst *call) {
+    auto ret = dyn_cast<ReturnInst>(call->next());
+    if (!ret || ret->opr.imm || ret->opr.var != call->dst)
+        return nullptr;
+    for (auto &arg: call->args) {
+        if (!arg.imm && arg.var->is_local() && arg.var->is_addr())
+            return nullptr;
+    }
+    return ret;
+}
+void EyrOptimizer::TailCalls::optimize(Module *mod) {
     for (auto fun: mod->global_funcs)
         runOnFunction(fun);
-    return flow_changed;
 }
-void EyrOptimizer::ConstFolder::runOnFunction(Function *fun) {
-    in_consts.clear(), out_consts.clear();
-    work_list.clear();
-
-    for (auto blk: fun->blocks)
-        work_list.insert(blk);
-
-    rewrite = false;
-    while (!work_list.empty()) {
-        auto it = work_list.begin();
-        auto blk = *it;
-        work_list.erase(it);
-        runOnBlock(blk);
+void EyrOptimizer::TailCalls::runOnFunction(Function *fun) {
+    std::vector<CallInst *> calls;
+    for (auto blk: fun->blocks) {
+        for (auto ins: blk->insts) {
+            auto call = dyn_cast<CallInst>(ins);
+            if (call && call->name == fun->name && returnOf(call))
+                calls.push_back(call);
+        }
     }
+    // a global array would be copied by value, see TgrEmitter::emitMoveInst
+    calls.erase(std::remove_if(calls.begin(), calls.end(), [](CallInst *call) {
+        for (auto &arg: call->args) {
+            if (!arg.imm && arg.var->is_addr())
+                return true;
+        }
+        return false;
+    }), calls.end());
+    if (calls.empty())
+        return;
 
-    rewrite = true;
-    for (auto blk: fun->blocks) {
-        runOnBlock(blk);
+    // the parameters are read in the entry, so loop back to a new block after it
+    auto top = fun->entry, entry = fun->allocBlock();
+    assert(!top->fall_in);
+    entry->fall(top);
+    fun->entry = entry;
+    for (auto call: calls) {
+        auto blk = call->block;
+        assert(!blk->fall_out && !blk->jump_out);
+        std::vector<Variable *> tmps;
+        for (auto &arg: call->args) {
+            tmps.push_back(fun->allocLocalVar());
+            call->addBefore(fun->module->make<MoveInst>(tmps.back(), arg));
+        }
+        for (size_t i = 0; i < tmps.size(); ++i)
+            call->addBefore(fun->module->make<MoveInst>(fun->params[i], Operand(tmps[i])));
+        auto ret = returnOf(call);
+        call->addBefore(fun->module->make<JumpInst>(top));
+        blk->jump(top);
+        call->remove(), ret->remove();
     }
     fun->arrangeBlock();
 }
-void EyrOptimizer::ConstFolder::runOnBlock(BasicBlock *blk) {
-    if (rewrite) {
-        cur_consts = in_consts[blk];
-        cur_ins = blk->insts.front();
-        while (cur_ins) {
-            runOnInstruction(cur_ins);
-        }
-    } else {
-        cur_consts.clear();
-        for (auto inb: blk->inBlocks()) {
-            for (auto vc: out_consts[inb]) {
-                auto v = vc.first;
-                auto c = vc.second;
-                if (cur_consts.count(v) == 0) {
-                    cur_consts[v] = c;
-                } else if (cur_consts[v] != c) {
-                    cur_consts[v] = {};
-                }
+void EyrOptimizer::TailCalls::mark(Module *mod) {
+    for (auto fun: mod->global_funcs) {
+        for (auto blk: fun->blocks) {
+            for (auto ins: blk->insts) {
+                auto call = dyn_cast<CallInst>(ins);
+                if (call && returnOf(call))
+                    call->tail = true;
             }
         }
-        in_consts[blk] = cur_consts;
-        for (auto ins: blk->insts) {
-            runOnInstruction(ins);
+    }
+}
+bool EyrOptimizer::Inliner::isRecursive(Function *fun) {
+    std::set<Function *> seen;
+    std::vector<Function *> work(callees[fun].begin(), callees[fun].end());
+    while (!work.empty()) {
+        auto f = work.back();
+        work.pop_back();
+        if (f == fun)
+            return true;
+        if (!seen.insert(f).second)
+            continue;
+        work.insert(work.end(), callees[f].begin(), callees[f].end());
+    }
+    return false;
+}
+bool EyrOptimizer::Inliner::shouldInline(Function *caller, Function *callee) {
+    if (callee == caller || isRecursive(callee))
+        return false;
+    if (sizes[caller] + sizes[callee] > MAX_CALLER_SIZE)
+        return false;
+    return sizes[callee] <= INLINE_SIZE || (call_sites[callee] == 1 && sizes[callee] <= INLINE_ONCE_SIZE);
+}
+void EyrOptimizer::Inliner::inlineCall(CallInst *call, Function *callee) {
+    auto blk = call->block;
+    auto fun = blk->func;
+    var_map.clear(), blk_map.clear();
+
+    std::vector<Instruction *> copies;
+    for (size_t i = 0; i < callee->params.size(); ++i) {
+        auto arg = call->args[i];
+        if (!arg.imm && arg.var->is_addr()) {
+            var_map[callee->params[i]] = arg.var;
+        } else {
+            auto var = fun->allocLocalVar();
+            var_map[callee->params[i]] = var;
+            copies.push_back(fun->module->make<MoveInst>(var, arg));
+        }
+    }
+    for (auto var: callee->local_vars)
+        var_map[var] = fun->allocLocalVar(var->is_temp(), var->width, var->is_addr());
+    for (auto b: callee->blocks)
+        blk_map[b] = fun->allocBlock();
+
+    // everything after the call continues in a block of its own
+    auto cont = fun->allocBlock();
+    for (auto ins = call->next(); ins;) {
+        auto next = ins->next();
+        ins->remove();
+        cont->addInst(ins);
+        ins = next;
+    }
+    if (auto out = blk->fall_out) {
+        blk->unfall();
+        cont->fall(out);
+    }
+    if (auto out = blk->jump_out) {
+        blk->unjump();
+        cont->jump(out);
+    }
+
+    for (auto b: callee->blocks) {
+        auto nb = blk_map[b];
+        bool returns = false;
+        for (auto ins: b->insts) {
+            if (auto ret = dyn_cast<ReturnInst>(ins)) {
+                nb->addInst(fun->module->make<MoveInst>(call->dst, mapOpr(ret->opr)));
+                returns = true;
+                break;
+            }
+            nb->addInst(visit(ins));
         }
-        if (out_consts[blk] != cur_consts) {
-            out_consts[blk] = cur_consts;
-            for (auto outb: blk->outBlocks())
-                work_list.insert(outb);
+        if (b->fall_out)
+            nb->fall(blk_map[b->fall_out]);
+        if (b->jump_out)
+            nb->jump(blk_map[b->jump_out]);
+        if (returns || (!b->fall_out && !b->jump_out)) {
+            nb->addInst(fun->module->make<JumpInst>(cont));
+            nb->jump(cont);
         }
     }
+
+    call->remove();
+    for (auto ins: copies)
+        blk->addInst(ins);
+    auto entry = blk_map[callee->entry];
+    if (entry->fall_in) {
+        blk->addInst(fun->module->make<JumpInst>(entry));
+        blk->jump(entry);
+    } else {
+        blk->fall(entry);
+    }
+}
+Instruction *EyrOptimizer::Inliner::visitBinaryInst(BinaryInst *i) {
+    return cur_mod->make<BinaryInst>(mapVar(i->dst), i->opt, mapOpr(i->lhs), mapOpr(i->rhs));
+}
+Instruction *EyrOptimizer::Inliner::visitUnaryInst(UnaryInst *i) {
+    return cur_mod->make<UnaryInst>(mapVar(i->dst), i->opt, mapOpr(i->opr));
+}
+Instruction *EyrOptimizer::Inliner::visitCallInst(CallInst *i) {
+    std::vector<Operand> args;
+    for (auto arg: i->args)
+        args.push_back(mapOpr(arg));
+    return cur_mod->make<CallInst>(mapVar(i->dst), i->name, args);
+}
+Instruction *EyrOptimizer::Inliner::visitMoveInst(MoveInst *i) {
+    return cur_mod->make<MoveInst>(mapVar(i->dst), mapOpr(i->src));
+}
+Instruction *EyrOptimizer::Inliner::visitStoreInst(StoreInst *i) {
+    return cur_mod->make<StoreInst>(mapVar(i->base), mapOpr(i->idx), mapOpr(i->src));
+}
+Instruction *EyrOptimizer::Inliner::visitLoadInst(LoadInst *i) {
+    return cur_mod->make<LoadInst>(mapVar(i->dst), mapVar(i->src), mapOpr(i->idx));
+}
+Instruction *EyrOptimizer::Inliner::visitBranchInst(BranchInst *i) {
+    return cur_mod->make<BranchInst>(blk_map[i->dst], i->opt, mapOpr(i->lhs), mapOpr(i->rhs));
 }
-void EyrOptimizer::ConstFolder::runOnInstruction(Instruction *ins) {
-#define MATCH(type) else if (auto i = dynamic_cast<type *>(ins)) { handle(i); }
-#define MATCHES MATCH(BinaryInst)MATCH(UnaryInst)MATCH(CallInst)MATCH(MoveInst)\
-MATCH(StoreInst)MATCH(LoadInst)MATCH(BranchInst)MATCH(JumpInst)MATCH(ReturnInst)
+Instruction *EyrOptimizer::Inliner::visitJumpInst(JumpInst *i) {
+    return cur_mod->make<JumpInst>(blk_map[i->dst]);
+}
+Variable *EyrOptimizer::Inliner::mapVar(Variable *var) {
+    auto it = var_map.find(var);
+    return it == var_map.end() ? var : it->second;
+}
+Operand EyrOptimizer::Inliner::mapOpr(Operand opr) {
+    return opr.imm ? opr : Operand(mapVar(opr.var));
+}
+void EyrOptimizer::SCCP::optimize(Module *mod) {
+    for (auto fun: mod->global_funcs)
+        runOnFunction(fun);
+}
+void EyrOptimizer::SCCP::runOnFunction(Function *fun) {
+    values.clear(), users.clear();
+    exec_edges.clear(), exec_blocks.clear();
+    flow_work.clear(), ssa_work.clear();
 
-    if (false) {
+    for (auto blk: fun->blocks) {
+        forwardGlobalConsts(blk);
+        for (auto ins: blk->insts) {
+            for (auto use: ins->uses())
+                users[use].push_back(ins);
+            for (auto def: ins->defs()) {
+                if (isSSAVar(def))
+                    values[def] = LatticeVal::UNDEF;
+            }
+        }
+    }
 
-    } MATCHES
-    else {
-        assert(false);
+    visitBlock(fun->entry);
+    while (!flow_work.empty() || !ssa_work.empty()) {
+        while (!flow_work.empty()) {
+            auto e = flow_work.back();
+            flow_work.pop_back();
+            if (!exec_edges.insert(e).second)
+                continue;
+            if (exec_blocks.count(e.second) == 0) {
+                visitBlock(e.second);
+            } else {
+                for (auto ins: e.second->insts) {
+                    if (!isa<PhiInst>(ins))
+                        break;
+                    visit(ins);
+                }
+            }
+        }
+        while (!ssa_work.empty()) {
+            auto ins = ssa_work.back();
+            ssa_work.pop_back();
+            if (exec_blocks.count(ins->block))
+                visit(ins);
+        }
     }
-    if (rewrite && cur_ins)
-        cur_ins = cur_ins->next();
 
-#undef MATCHES
-#undef MATCH
+    for (auto blk: fun->blocks)
+        rewrite(blk);
+    fun->arrangeBlock();
+}
+// scalar globals are not renamed, only forward "g = c" until the next call
+void EyrOptimizer::SCCP::forwardGlobalConsts(BasicBlock *blk) {
+    std::map<Variable *, int> known;
+    for (auto ins: blk->insts) {
+        for (auto use: ins->uses()) {
+            auto it = known.find(use);
+            if (it != known.end())
+                ins->replaceUse(use, Operand(it->second));
+        }
+        if (isa<CallInst>(ins))
+            known.clear();
+        for (auto def: ins->defs())
+            known.erase(def);
+        auto mov = dyn_cast<MoveInst>(ins);
+        if (mov && mov->dst->is_global() && mov->src.imm)
+            known[mov->dst] = mov->src.val;
+    }
+}
+void EyrOptimizer::SCCP::markEdge(BasicBlock *from, BasicBlock *to) {
+    if (to && exec_edges.count({from, to}) == 0)
+        flow_work.push_back({from, to});
+}
+void EyrOptimizer::SCCP::visitBlock(BasicBlock *blk) {
+    exec_blocks.insert(blk);
+    for (auto ins: blk->insts)
+        visit(ins);
+    auto last = blk->insts.empty() ? nullptr : blk->insts.back();
+    if (!isa<JumpInst>(last) && !isa<ReturnInst>(last))
+        markEdge(blk, blk->fall_out);
+}
+void EyrOptimizer::SCCP::visitPhiInst(PhiInst *phi) {
+    LatticeVal val;
+    for (auto &src: phi->srcs) {
+        if (exec_edges.count({src.first, phi->block}))
+            val = meet(val, valueOf(src.second));
+    }
+    setValue(phi->dst, val);
+}
+void EyrOptimizer::SCCP::visitBinaryInst(BinaryInst *bin) {
+    setValue(bin->dst, evalBinary(bin->opt, valueOf(bin->lhs), valueOf(bin->rhs)));
+}
+void EyrOptimizer::SCCP::visitUnaryInst(UnaryInst *un) {
+    auto opr = valueOf(un->opr);
+    LatticeVal val = opr;
+    if (opr.kind == LatticeVal::CONST) {
+        switch (un->opt) {
+            when(UnaryInst::UnOp::NEG, val = static_cast<int>(0u - opr.val);)
+            when(UnaryInst::UnOp::NOT, val = !opr.val;)
+            default:
+                assert(false);
+        }
+    }
+    setValue(un->dst, val);
 }
-void EyrOptimizer::ConstFolder::handle(BinaryInst *ins) {
-#define MATCH(match, op) when(BinaryInst::BinOp::match, c = lc op rc;)
-#define MATCHES  MATCH(EQ, ==)MATCH(NE, !=)MATCH(LT, <)MATCH(GT, >)MATCH(OR, ||)\
-MATCH(AND, &&)MATCH(ADD, +)MATCH(SUB, -)MATCH(MUL, *)MATCH(DIV, /)MATCH(REM, %)
+void EyrOptimizer::SCCP::visitMoveInst(MoveInst *mov) {
+    setValue(mov->dst, valueOf(mov->src));
+}
+void EyrOptimizer::SCCP::visitAssignInst(AssignInst *asg) {
+    setValue(asg->dst, LatticeVal::OVERDEF); // call, load
+}
+void EyrOptimizer::SCCP::visitJumpInst(JumpInst *jmp) {
+    markEdge(jmp->block, jmp->block->jump_out);
+}
+void EyrOptimizer::SCCP::visitInstruction(Instruction *ins) {
+    // stores and returns define nothing
+}
+void EyrOptimizer::SCCP::visitBranchInst(BranchInst *ins) {
+    // GE and LE are the negations of LT and GT
+    bool negate = ins->opt == BranchInst::LgcOp::GE || ins->opt == BranchInst::LgcOp::LE;
+    auto op = ins->opt == BranchInst::LgcOp::GE ? BinaryInst::BinOp::LT :
+              ins->opt == BranchInst::LgcOp::LE ? BinaryInst::BinOp::GT :
+              static_cast<BinaryInst::BinOp>(static_cast<int>(ins->opt));
+    auto cond = evalBinary(op, valueOf(ins->lhs), valueOf(ins->rhs));
+    if (negate && cond.kind == LatticeVal::CONST)
+        cond = LatticeVal(!cond.val);
+    auto blk = ins->block;
+    if (cond.kind == LatticeVal::UNDEF)
+        return;
+    if (cond.kind == LatticeVal::OVERDEF || !cond.val)
+        markEdge(blk, blk->fall_out);
+    if (cond.kind == LatticeVal::OVERDEF || cond.val)
+        markEdge(blk, blk->jump_out);
+}
+void EyrOptimizer::SCCP::setValue(Variable *var, LatticeVal val) {
+    auto it = values.find(var);
+    if (it == values.end() || it->second == val)
+        return;
+    it->second = val;
+    for (auto user: users[var])
+        ssa_work.push_back(user);
+}
+EyrOptimizer::SCCP::LatticeVal EyrOptimizer::SCCP::valueOf(Operand opr) {
+    if (opr.imm)
+        return opr.val;
+    // globals, arrays, parameters and uninitialized locals
+    auto it = values.find(opr.var);
+    return it == values.end() ? LatticeVal::OVERDEF : it->second;
+}
+EyrOptimizer::SCCP::LatticeVal EyrOptimizer::SCCP::meet(LatticeVal a, LatticeVal b) {
+    if (a.kind == LatticeVal::UNDEF)
+        return b;
+    if (b.kind == LatticeVal::UNDEF)
+        return a;
+    if (a == b)
+        return a;
+    return LatticeVal::OVERDEF;
+}
+EyrOptimizer::SCCP::LatticeVal
+EyrOptimizer::SCCP::evalBinary(BinaryInst::BinOp op, LatticeVal l, LatticeVal r) {
+#define MATCH(match, op) when(BinaryInst::BinOp::match, return lc op rc;)
+#define MATCHES  MATCH(EQ, ==)MATCH(NE, !=)MATCH(LT, <)MATCH(GT, >)MATCH(OR, ||)MATCH(AND, &&)
+#define WRAP(match, op) when(BinaryInst::BinOp::match, return static_cast<int>(ulc op urc);)
+#define WRAPS WRAP(ADD, +)WRAP(SUB, -)WRAP(MUL, *)
 
-    if (isConst(ins->lhs) && isConst(ins->rhs)) {
-        auto lc = getConst(ins->lhs), rc = getConst(ins->rhs);
-        int c = 0;
-        switch (ins->opt) {
+    bool lk = l.kind == LatticeVal::CONST, rk = r.kind == LatticeVal::CONST;
+    if (lk && rk) {
+        int lc = l.val, rc = r.val;
+        unsigned ulc = lc, urc = rc;
+        switch (op) {
             MATCHES
+            WRAPS
+            case BinaryInst::BinOp::DIV:
+            case BinaryInst::BinOp::REM:
+                // leave traps to run time
+                if (rc == 0 || (lc == INT_MIN && rc == -1))
+                    return LatticeVal::OVERDEF;
+                return op == BinaryInst::BinOp::DIV ? lc / rc : lc % rc;
             default:
                 assert(false);
         }
-        cur_consts[ins->dst] = c;
-        if (rewrite) {
-            cur_ins = ins->addAfter(new MoveInst(ins->dst, Operand(c)));
-            ins->remove();
-        }
-    } else {
-        if (rewrite) {
-            if (isConst(ins->lhs))
-                ins->lhs = Operand(getConst(ins->lhs));
-            if (isConst(ins->rhs))
-                ins->rhs = Operand(getConst(ins->rhs));
-        }
-        cur_consts[ins->dst] = {};
     }
+    // results decided by one operand alone
+    if ((lk && !l.val) || (rk && !r.val)) {
+        if (op == BinaryInst::BinOp::MUL || op == BinaryInst::BinOp::AND)
+            return 0;
+    }
+    if ((lk && l.val) || (rk && r.val)) {
+        if (op == BinaryInst::BinOp::OR)
+            return 1;
+    }
+    if (l.kind == LatticeVal::UNDEF || r.kind == LatticeVal::UNDEF)
+        return LatticeVal::UNDEF;
+    return LatticeVal::OVERDEF;
 
+#undef WRAPS
+#undef WRAP
 #undef MATCHES
 #undef MATCH
 }
-void EyrOptimizer::ConstFolder::handle(UnaryInst *ins) {
-    if (isConst(ins->opr)) {
-        auto oc = getConst(ins->opr);
-        int c = 0;
-        switch (ins->opt) {
-            when(UnaryInst::UnOp::NEG, c = -oc;)
-            when(UnaryInst::UnOp::NOT, c = !oc;)
-            default:
-                assert(false);
+void EyrOptimizer::SCCP::rewrite(BasicBlock *blk) {
+    auto ins = blk->insts.empty() ? nullptr : blk->insts.front();
+    while (ins) {
+        auto next = ins->next();
+        for (auto use: ins->uses()) {
+            auto val = valueOf(Operand(use));
+            if (val.kind == LatticeVal::CONST)
+                ins->replaceUse(use, Operand(val.val));
         }
-        cur_consts[ins->dst] = c;
-        if (rewrite) {
-            cur_ins = ins->addAfter(new MoveInst(ins->dst, Operand(c)));
+        auto asg = dyn_cast<AssignInst>(ins);
+        auto br = dyn_cast<BranchInst>(ins);
+        if (asg && !isa<CallInst>(ins) && valueOf(Operand(asg->dst)).kind == LatticeVal::CONST) {
             ins->remove();
+        } else if (br && exec_blocks.count(blk)) {
+            bool fall = exec_edges.count({blk, blk->fall_out}) > 0;
+            bool jump = exec_edges.count({blk, blk->jump_out}) > 0;
+            if (fall != jump)
+                foldBranch(br, jump);
         }
+        ins = next;
+    }
+}
+void EyrOptimizer::SCCP::foldBranch(BranchInst *ins, bool taken) {
+    auto blk = ins->block;
+    auto kept = taken ? blk->jump_out : blk->fall_out;
+    auto dropped = taken ? blk->fall_out : blk->jump_out;
+    if (dropped != kept) {
+        for (auto i: dropped->insts) {
+            auto phi = dyn_cast<PhiInst>(i);
+            if (!phi)
+                break;
+            phi->removeSrc(blk);
+        }
+    }
+    if (taken) {
+        blk->unfall();
+        ins->addAfter(blk->func->module->make<JumpInst>(kept));
     } else {
-        cur_consts[ins->dst] = {};
+        blk->unjump();
     }
+    ins->remove();
 }
-void EyrOptimizer::ConstFolder::handle(CallInst *ins) {
-    if (rewrite) {
-        int len = ins->args.size();
-        for (int i = 0; i < len; ++i) {
-            if (isConst(ins->args[i]))
-                ins->args[i] = Operand(getConst(ins->args[i]));
+// whether stores through one base may change what is read through the other:
+// arrays are distinct from each other, a pointer may point into any of them
+static bool mayAlias(Variable *a, Variable *b) {
+    return a == b || !a->is_addr() || !b->is_addr();
+}
+void EyrOptimizer::GVN::optimize(Module *mod) {
+    for (auto fun: mod->global_funcs)
+        runOnFunction(fun);
+}
+void EyrOptimizer::GVN::runOnFunction(Function *fun) {
+    DominatorTree dt(fun);
+    dom_tree = &dt;
+    leaders.clear(), exprs.clear();
+    runOnBlock(fun->entry, {});
+    dom_tree = nullptr;
+}
+void EyrOptimizer::GVN::runOnBlock(BasicBlock *blk, KeyTable loads) {
+    std::vector<Key> scope;
+    auto ins = blk->insts.empty() ? nullptr : blk->insts.front();
+    while (ins) {
+        auto next = ins->next();
+        if (numberInst(ins, loads, scope)) {
+            ins->remove();
+        }
+        ins = next;
+    }
+    for (auto succ: blk->outBlocks()) {
+        for (auto i: succ->insts) {
+            auto phi = dyn_cast<PhiInst>(i);
+            if (!phi)
+                break;
+            auto &src = phi->srcOf(blk);
+            src = leaderOf(src);
+        }
+    }
+    for (auto c: dom_tree->children(blk)) {
+        // memory is unchanged between the end of blk and a block only it can reach
+        bool only_pred = true;
+        for (auto pred: c->inBlocks())
+            only_pred = only_pred && pred == blk;
+        runOnBlock(c, only_pred ? loads : KeyTable());
+    }
+    for (auto &key: scope)
+        exprs.erase(key);
+}
+bool EyrOptimizer::GVN::numberInst(Instruction *ins, KeyTable &loads, std::vector<Key> &scope) {
+    if (isa<PhiInst>(ins))
+        return false;
+    for (auto use: ins->uses()) {
+        auto leader = leaderOf(Operand(use));
+        if (leader.imm || leader.var != use)
+            ins->replaceUse(use, leader);
+    }
+
+    // globals are not renamed, their value may differ between two reads
+    auto asg = dyn_cast<AssignInst>(ins);
+    bool ssa_dst = asg && isSSAVar(asg->dst);
+    auto ssa_opr = [](Operand opr) { return opr.imm || isSSAVar(opr.var); };
+    auto redundant = [&](KeyTable &table, const Key &key) {
+        auto it = table.find(key);
+        if (it != table.end()) {
+            leaders[asg->dst] = it->second;
+            return true;
+        }
+        table[key] = Operand(asg->dst);
+        return false;
+    };
+    switch (ins->kind) {
+        case Instruction::Kind::MOVE: {
+            auto mov = static_cast<MoveInst *>(ins);
+            if (ssa_dst && ssa_opr(mov->src)) {
+                leaders[mov->dst] = mov->src;
+                return true;
+            }
+            break;
+        }
+        case Instruction::Kind::BINARY: {
+            auto bin = static_cast<BinaryInst *>(ins);
+            if (!ssa_dst || !ssa_opr(bin->lhs) || !ssa_opr(bin->rhs))
+                return false;
+            auto key = makeKey(0, static_cast<int>(bin->opt), bin->lhs, bin->rhs);
+            if (redundant(exprs, key))
+                return true;
+            scope.push_back(key);
+            break;
+        }
+        case Instruction::Kind::UNARY: {
+            auto un = static_cast<UnaryInst *>(ins);
+            if (!ssa_dst || !ssa_opr(un->opr))
+                return false;
+            auto key = makeKey(1, static_cast<int>(un->opt), un->opr, Operand(0));
+            if (redundant(exprs, key))
+                return true;
+            scope.push_back(key);
+            break;
         }
+        case Instruction::Kind::LOAD: {
+            auto ld = static_cast<LoadInst *>(ins);
+            if (ssa_dst && ssa_opr(ld->idx))
+                return redundant(loads, makeKey(2, 0, Operand(ld->src), ld->idx));
+            break;
+        }
+        case Instruction::Kind::STORE: {
+            auto st = static_cast<StoreInst *>(ins);
+            killLoads(loads, st->base);
+            if (ssa_opr(st->src) && ssa_opr(st->idx))
+                loads[makeKey(2, 0, Operand(st->base), st->idx)] = st->src;
+            break;
+        }
+        when(Instruction::Kind::CALL, loads.clear();)
+        default:
+            break;
     }
-    for (auto vc: cur_consts) {
-        if (vc.first->is_global())
-            cur_consts[vc.first] = {};
+    return false;
+}
+void EyrOptimizer::GVN::killLoads(KeyTable &loads, Variable *base) {
+    for (auto it = loads.begin(); it != loads.end();) {
+        auto b = reinterpret_cast<Variable *>(std::get<3>(it->first));
+        if (mayAlias(b, base))
+            it = loads.erase(it);
+        else
+            ++it;
     }
-    cur_consts[ins->dst] = {};
 }
-void EyrOptimizer::ConstFolder::handle(MoveInst *ins) {
-    if (isConst(ins->src)) {
-        if (rewrite) {
-            ins->src = Operand(getConst(ins->src));
+Operand EyrOptimizer::GVN::leaderOf(Operand opr) {
+    if (opr.imm)
+        return opr;
+    auto it = leaders.find(opr.var);
+    return it == leaders.end() ? opr : it->second;
+}
+EyrOptimizer::GVN::Key EyrOptimizer::GVN::makeKey(int kind, int opt, Operand l, Operand r) {
+    using BinOp = BinaryInst::BinOp;
+    auto code = [](Operand o) -> intptr_t {
+        return o.imm ? o.val : reinterpret_cast<intptr_t>(o.var);
+    };
+    if (kind == 0) {
+        auto op = static_cast<BinOp>(opt);
+        bool commutative = op == BinOp::EQ || op == BinOp::NE || op == BinOp::OR ||
+                           op == BinOp::AND || op == BinOp::ADD || op == BinOp::MUL;
+        if (op == BinOp::GT) {
+            opt = static_cast<int>(BinOp::LT);
+            std::swap(l, r);
+        } else if (commutative && std::make_pair(l.imm, code(l)) > std::make_pair(r.imm, code(r))) {
+            std::swap(l, r);
         }
-        cur_consts[ins->dst] = getConst(ins->src);
-    } else {
-        cur_consts[ins->dst] = {};
     }
+    return Key(kind, opt, l.imm, code(l), r.imm, code(r));
 }
-void EyrOptimizer::ConstFolder::handle(StoreInst *ins) {
-    if (rewrite) {
-        if (isConst(ins->src))
-            ins->src = Operand(getConst(ins->src));
-        if (isConst(ins->idx))
-            ins->idx = Operand(getConst(ins->idx));
+void EyrOptimizer::LICM::optimize(Module *mod) {
+    for (auto fun: mod->global_funcs)
+        runOnFunction(fun);
+}
+void EyrOptimizer::LICM::runOnFunction(Function *fun) {
+    cur_func = fun;
+    bool inserted = false;
+    {
+        DominatorTree dt(fun);
+        for (auto &loop: findLoops(dt)) {
+            insertPreheader(loop);
+            inserted = true;
+        }
     }
+    if (!inserted)
+        return;
+    fun->arrangeBlock();
+    // preheaders of inner loops now belong to the outer ones
+    DominatorTree dt(fun);
+    for (auto &loop: findLoops(dt))
+        hoist(loop, dt);
 }
-void EyrOptimizer::ConstFolder::handle(LoadInst *ins) {
-    if (rewrite) {
-        if (isConst(ins->idx))
-            ins->idx = Operand(getConst(ins->idx));
+static std::vector<BasicBlock *> outsidePreds(const Loop &loop) {
+    std::vector<BasicBlock *> res;
+    for (auto pred: loop.header->inBlocks()) {
+        if (!loop.blocks.count(pred) && std::find(res.begin(), res.end(), pred) == res.end())
+            res.push_back(pred);
     }
-    cur_consts[ins->dst] = {};
+    return res;
 }
-void EyrOptimizer::ConstFolder::handle(BranchInst *ins) {
-#define MATCH(match, op) when(BranchInst::LgcOp::match, c = lc op rc;)
-#define MATCHES  MATCH(EQ, ==)MATCH(NE, !=)MATCH(LT, <)MATCH(GT, >)MATCH(OR, ||)MATCH(AND, &&)
+void EyrOptimizer::LICM::insertPreheader(const Loop &loop) {
+    auto header = loop.header;
+    auto outs = outsidePreds(loop);
+    assert(!outs.empty());
+    if (outs.size() == 1 && outs[0]->outBlocks() == std::vector<BasicBlock *>{header})
+        return;
 
-    if (rewrite) {
-        if (isConst(ins->lhs))
-            ins->lhs = Operand(getConst(ins->lhs));
-        if (isConst(ins->rhs))
-            ins->rhs = Operand(getConst(ins->rhs));
-        if (isConst(ins->lhs) && isConst(ins->rhs)) {
-            auto lc = getConst(ins->lhs), rc = getConst(ins->rhs);
-            int c = 0;
-            switch (ins->opt) {
-                MATCHES
-                default:
-                    assert(false);
-            }
-            if (c) {
-                ins->block->unfall();
-                cur_ins = ins->addAfter(new JumpInst(ins->block->jump_out));
-                ins->remove();
-                flow_changed = true;
-            } else {
-                ins->block->unjump();
-                cur_ins = ins->next();
+    auto pre = cur_func->allocBlock();
+    for (auto i: header->insts) {
+        auto phi = dyn_cast<PhiInst>(i);
+        if (!phi)
+            break;
+        auto val = phi->srcOf(outs[0]);
+        bool same = true;
+        for (auto pred: outs) {
+            auto src = phi->srcOf(pred);
+            same = same && src.imm == val.imm && (src.imm ? src.val == val.val : src.var == val.var);
+        }
+        if (!same) {
+            auto merge = cur_func->module->make<PhiInst>(cur_func->allocLocalVar());
+            for (auto pred: outs)
+                merge->srcs.push_back({pred, phi->srcOf(pred)});
+            pre->addInst(merge);
+            val = Operand(merge->dst);
+        }
+        for (auto pred: outs)
+            phi->removeSrc(pred);
+        phi->srcs.push_back({pre, val});
+    }
+    for (auto pred: outs) {
+        if (pred->fall_out == header) {
+            pred->unfall();
+            pred->fall(pre);
+        }
+        if (pred->jump_out == header) {
+            auto jmp = dyn_cast<JumpInst>(pred->insts.back());
+            assert(jmp && jmp->dst == header);
+            jmp->dst = pre;
+            pred->unjump();
+            pred->jump(pre);
+        }
+    }
+    if (header->fall_in) {
+        pre->addInst(cur_func->module->make<JumpInst>(header));
+        pre->jump(header);
+    } else {
+        pre->fall(header);
+    }
+}
+void EyrOptimizer::LICM::hoist(const Loop &loop, const DominatorTree &dom_tree) {
+    auto outs = outsidePreds(loop);
+    assert(outs.size() == 1);
+    auto pre = outs[0];
+
+    loop_defs.clear(), stored_bases.clear();
+    has_call = false;
+    std::vector<BasicBlock *> exits;
+    for (auto blk: loop.blocks) {
+        for (auto ins: blk->insts) {
+            for (auto def: ins->defs())
+                loop_defs.insert(def);
+            if (auto st = dyn_cast<StoreInst>(ins))
+                stored_bases.push_back(st->base);
+            has_call = has_call || isa<CallInst>(ins);
+        }
+        for (auto succ: blk->outBlocks()) {
+            if (!loop.blocks.count(succ))
+                exits.push_back(blk);
+        }
+    }
+
+    for (auto blk: dom_tree.rpo()) {
+        if (!loop.blocks.count(blk))
+            continue;
+        bool always_runs = true;
+        for (auto e: exits)
+            always_runs = always_runs && dom_tree.dominates(blk, e);
+        auto ins = blk->insts.empty() ? nullptr : blk->insts.front();
+        while (ins) {
+            auto next = ins->next();
+            if (canHoist(ins, always_runs)) {
                 ins->remove();
-                flow_changed = true;
+                auto last = pre->insts.empty() ? nullptr : pre->insts.back();
+                if (isa<JumpInst>(last))
+                    last->addBefore(ins);
+                else
+                    pre->addInst(ins);
+                loop_defs.erase(static_cast<AssignInst *>(ins)->dst);
             }
+            ins = next;
+        }
+    }
+}
+// the preheader runs even if the loop body does not, so nothing that may trap moves
+bool EyrOptimizer::LICM::canHoist(Instruction *ins, bool always_runs) {
+    auto asg = dyn_cast<AssignInst>(ins);
+    if (!asg || !isSSAVar(asg->dst))
+        return false;
+    switch (ins->kind) {
+        case Instruction::Kind::BINARY: {
+            auto bin = static_cast<BinaryInst *>(ins);
+            if (bin->opt == BinaryInst::BinOp::DIV || bin->opt == BinaryInst::BinOp::REM) {
+                if (!bin->rhs.imm || bin->rhs.val == 0 || bin->rhs.val == -1)
+                    return false;
+            }
+            return isInvariant(bin->lhs) && isInvariant(bin->rhs);
+        }
+        case Instruction::Kind::UNARY:
+            return isInvariant(static_cast<UnaryInst *>(ins)->opr);
+        case Instruction::Kind::MOVE:
+            return isInvariant(static_cast<MoveInst *>(ins)->src);
+        case Instruction::Kind::LOAD: {
+            auto ld = static_cast<LoadInst *>(ins);
+            if (!isInvariant(Operand(ld->src)) || !isInvariant(ld->idx) || mayBeStored(ld->src))
+                return false;
+            auto &idx = ld->idx;
+            bool in_bounds = ld->src->is_addr() && idx.imm && idx.val >= 0 && idx.val < ld->src->width;
+            return in_bounds || always_runs;
+        }
+        default: // phis, calls
+            return false;
+    }
+}
+bool EyrOptimizer::LICM::isInvariant(Operand opr) {
+    if (opr.imm || opr.var->is_addr())
+        return true;
+    if (opr.var->is_global() && has_call)
+        return false;
+    return loop_defs.count(opr.var) == 0;
+}
+bool EyrOptimizer::LICM::mayBeStored(Variable *base) {
+    if (has_call)
+        return true;
+    for (auto b: stored_bases) {
+        if (mayAlias(b, base))
+            return true;
+    }
+    return false;
+}
+void EyrOptimizer::StrengthReducer::optimize(Module *mod) {
+    for (auto fun: mod->global_funcs)
+        runOnFunction(fun);
+}
+void EyrOptimizer::StrengthReducer::runOnFunction(Function *fun) {
+    cur_func = fun;
+    def_of.clear(), users.clear();
+    for (auto blk: fun->blocks) {
+        for (auto ins: blk->insts) {
+            for (auto def: ins->defs())
+                def_of[def] = ins;
+            for (auto use: ins->uses())
+                users[use].push_back(ins);
         }
     }
+    DominatorTree dt(fun);
+    for (auto &loop: findLoops(dt))
+        runOnLoop(loop);
+}
+void EyrOptimizer::StrengthReducer::runOnLoop(const Loop &loop) {
+    auto outs = outsidePreds(loop);
+    if (outs.size() != 1)
+        return;
+    auto pre = outs[0], header = loop.header;
 
-#undef MATCHES
-#undef MATCH
+    std::vector<BinaryInst *> products;
+    for (auto blk: loop.blocks) {
+        for (auto ins: blk->insts) {
+            auto bin = dyn_cast<BinaryInst>(ins);
+            if (bin && bin->opt == BinaryInst::BinOp::MUL && isSSAVar(bin->dst) &&
+                bin->lhs.imm != bin->rhs.imm)
+                products.push_back(bin);
+        }
+    }
+    std::vector<PhiInst *> phis;
+    for (auto ins: header->insts) {
+        auto phi = dyn_cast<PhiInst>(ins);
+        if (!phi)
+            break;
+        phis.push_back(phi);
+    }
+
+    for (auto phi: phis) {
+        if (phi->srcs.size() != 2)
+            continue;
+        auto latch = phi->srcs[0].first == pre ? phi->srcs[1].first : phi->srcs[0].first;
+        int step = 0;
+        auto inc = stepOf(phi, latch, step);
+        if (!inc)
+            continue;
+        auto init = phi->srcOf(pre);
+
+        std::map<int, Variable *> scaled; // factor -> induction variable
+        for (auto &bin: products) {
+            if (!bin)
+                continue;
+            auto var = bin->lhs.imm ? bin->rhs : bin->lhs;
+            int k = bin->lhs.imm ? bin->lhs.val : bin->rhs.val;
+            if (var.var != phi->dst)
+                continue;
+            auto it = scaled.find(k);
+            if (it == scaled.end()) {
+                auto iv = cur_func->allocLocalVar(), next = cur_func->allocLocalVar();
+                Operand start;
+                if (init.imm) {
+                    start = Operand(static_cast<int>(static_cast<unsigned>(init.val) * k));
+                } else {
+                    start = Operand(cur_func->allocLocalVar());
+                    auto mul = cur_func->module->make<BinaryInst>(start.var, BinaryInst::BinOp::MUL, init, Operand(k));
+                    auto last = pre->insts.empty() ? nullptr : pre->insts.back();
+                    if (isa<JumpInst>(last))
+                        last->addBefore(mul);
+                    else
+                        pre->addInst(mul);
+                }
+                auto iv_phi = cur_func->module->make<PhiInst>(iv);
+                iv_phi->srcs.push_back({pre, start});
+                iv_phi->srcs.push_back({latch, Operand(next)});
+                phi->addBefore(iv_phi);
+                auto step_k = static_cast<int>(static_cast<unsigned>(step) * k);
+                inc->addAfter(cur_func->module->make<BinaryInst>(next, BinaryInst::BinOp::ADD,
+                                                                 Operand(iv), Operand(step_k)));
+                it = scaled.insert({k, iv}).first;
+            }
+            for (auto user: users[bin->dst])
+                user->replaceUse(bin->dst, Operand(it->second));
+            bin->remove();
+            bin = nullptr;
+        }
+    }
 }
-void EyrOptimizer::ConstFolder::handle(JumpInst *ins) {
-    (void) cur_consts;
+// the increment i + c (or i - c) feeding phi = phi(init, i + c) from the latch
+BinaryInst *EyrOptimizer::StrengthReducer::stepOf(PhiInst *phi, BasicBlock *latch, int &step) {
+    auto next = phi->srcOf(latch);
+    if (next.imm)
+        return nullptr;
+    auto it = def_of.find(next.var);
+    auto bin = it == def_of.end() ? nullptr : dyn_cast<BinaryInst>(it->second);
+    if (!bin)
+        return nullptr;
+    auto is_iv = [phi](Operand opr) { return !opr.imm && opr.var == phi->dst; };
+    if (bin->opt == BinaryInst::BinOp::ADD && is_iv(bin->lhs) && bin->rhs.imm) {
+        step = bin->rhs.val;
+    } else if (bin->opt == BinaryInst::BinOp::ADD && is_iv(bin->rhs) && bin->lhs.imm) {
+        step = bin->lhs.val;
+    } else if (bin->opt == BinaryInst::BinOp::SUB && is_iv(bin->lhs) && bin->rhs.imm) {
+        step = static_cast<int>(0u - bin->rhs.val);
+    } else {
+        return nullptr;
+    }
+    return bin;
 }
-void EyrOptimizer::ConstFolder::handle(ReturnInst *ins) {
-    if (rewrite) {
-        if (isConst(ins->opr))
-            ins->opr = Operand(getConst(ins->opr));
+void EyrOptimizer::BranchFuser::optimize(Module *mod) {
+    for (auto fun: mod->global_funcs)
+        runOnFunction(fun);
+}
+void EyrOptimizer::BranchFuser::runOnFunction(Function *fun) {
+    use_count.clear();
+    for (auto blk: fun->blocks) {
+        for (auto ins: blk->insts) {
+            for (auto use: ins->uses())
+                ++use_count[use];
+        }
+    }
+    for (auto blk: fun->blocks) {
+        auto br = blk->insts.empty() ? nullptr : dyn_cast<BranchInst>(blk->insts.back());
+        while (br && fuse(br));
     }
 }
-bool EyrOptimizer::ConstFolder::isConst(Operand opr) {
-    if (opr.imm)
-        return true;
-    auto it = cur_consts.find(opr.var);
-    if (it == cur_consts.end())
+static BranchInst::LgcOp invert(BranchInst::LgcOp op) {
+    switch (op) {
+        case BranchInst::LgcOp::EQ: return BranchInst::LgcOp::NE;
+        case BranchInst::LgcOp::NE: return BranchInst::LgcOp::EQ;
+        case BranchInst::LgcOp::LT: return BranchInst::LgcOp::GE;
+        case BranchInst::LgcOp::GT: return BranchInst::LgcOp::LE;
+        case BranchInst::LgcOp::GE: return BranchInst::LgcOp::LT;
+        case BranchInst::LgcOp::LE: return BranchInst::LgcOp::GT;
+        default:
+            assert(false);
+            return op;
+    }
+}
+// if t != 0 / if t == 0, where t is defined in the block and used only here
+bool EyrOptimizer::BranchFuser::fuse(BranchInst *br) {
+    if (br->opt != BranchInst::LgcOp::NE && br->opt != BranchInst::LgcOp::EQ)
         return false;
-    return it->second.is_const;
+    if (br->lhs.imm || !br->rhs.imm || br->rhs.val != 0)
+        return false;
+    auto t = br->lhs.var;
+    if (!isSSAVar(t) || use_count[t] != 1)
+        return false;
+    AssignInst *def = nullptr;
+    for (auto ins = br->prev(); ins && !def; ins = ins->prev()) {
+        auto asg = dyn_cast<AssignInst>(ins);
+        if (asg && asg->dst == t)
+            def = asg;
+    }
+
+    bool negate = br->opt == BranchInst::LgcOp::EQ;
+    BranchInst::LgcOp op;
+    Operand lhs, rhs;
+    if (auto bin = dyn_cast<BinaryInst>(def)) {
+        if (bin->opt < BinaryInst::BinOp::EQ || bin->opt > BinaryInst::BinOp::GT)
+            return false;
+        op = static_cast<BranchInst::LgcOp>(static_cast<int>(bin->opt));
+        lhs = bin->lhs, rhs = bin->rhs;
+    } else if (auto un = dyn_cast<UnaryInst>(def)) {
+        if (un->opt != UnaryInst::UnOp::NOT)
+            return false;
+        op = BranchInst::LgcOp::EQ;
+        lhs = un->opr, rhs = Operand(0);
+    } else {
+        return false;
+    }
+    // globals read by the comparison must keep their value until the branch
+    for (auto ins = def->next(); ins != br; ins = ins->next()) {
+        if (isa<CallInst>(ins))
+            return false;
+        for (auto d: ins->defs()) {
+            if ((!lhs.imm && lhs.var == d) || (!rhs.imm && rhs.var == d))
+                return false;
+        }
+    }
+    br->opt = negate ? invert(op) : op;
+    br->lhs = lhs, br->rhs = rhs;
+    def->remove();
+    return true;
+}
+
+// probability of taking a loop back edge or staying in the loop, and of branching to a return
+static const double LOOP_PROB = 0.88;
+static const double RETURN_PROB = 0.28;
+
+void EyrOptimizer::BlockLayout::optimize(Module *mod) {
+    for (auto fun: mod->global_funcs)
+        runOnFunction(fun);
+}
+void EyrOptimizer::BlockLayout::runOnFunction(Function *fun) {
+    fun->arrangeBlock();
+    weighEdges(fun);
+    buildChains();
+    relink(fun, orderChains(fun));
+}
+static bool endsWithReturn(BasicBlock *blk) {
+    return !blk->insts.empty() && isa<ReturnInst>(blk->insts.back());
+}
+void EyrOptimizer::BlockLayout::weighEdges(Function *fun) {
+    edges.clear();
+    DominatorTree dt(fun);
+    auto loops = findLoops(dt);
+    std::map<BasicBlock *, const Loop *> innermost;
+    std::map<BasicBlock *, double> freq;
+    for (auto blk: fun->blocks)
+        freq[blk] = 1;
+    for (auto &loop: loops) {
+        for (auto blk: loop.blocks) {
+            freq[blk] *= 8;
+            if (!innermost.count(blk))
+                innermost[blk] = &loop;
+        }
+    }
+
+    for (auto blk: fun->blocks) {
+        auto br = blk->insts.empty() ? nullptr : dyn_cast<BranchInst>(blk->insts.back());
+        if (!br || blk->fall_out == blk->jump_out) {
+            if (auto succ = blk->jump_out ? blk->jump_out : blk->fall_out)
+                edges.push_back({blk, succ, freq[blk]});
+            continue;
+        }
+        auto taken = blk->jump_out, not_taken = blk->fall_out;
+        auto loop = innermost.count(blk) ? innermost[blk] : nullptr;
+        auto back = [&](BasicBlock *succ) { return dt.dominates(succ, blk); };
+        auto exits = [&](BasicBlock *succ) { return loop && !loop->blocks.count(succ); };
+        double prob = 0.5; // of the taken edge
+        if (back(taken) != back(not_taken))
+            prob = back(taken) ? LOOP_PROB : 1 - LOOP_PROB;
+        else if (exits(taken) != exits(not_taken))
+            prob = exits(taken) ? 1 - LOOP_PROB : LOOP_PROB;
+        else if (endsWithReturn(taken) != endsWithReturn(not_taken))
+            prob = endsWithReturn(taken) ? RETURN_PROB : 1 - RETURN_PROB;
+        edges.push_back({blk, taken, freq[blk] * prob});
+        edges.push_back({blk, not_taken, freq[blk] * (1 - prob)});
+    }
+    std::stable_sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+        return a.weight > b.weight;
+    });
+}
+// heaviest edges first, joining the tail of a chain to the head of another
+void EyrOptimizer::BlockLayout::buildChains() {
+    chain_next.clear(), chain_prev.clear();
+    for (auto &e: edges) {
+        if (e.from == e.to || e.to == e.from->func->entry)
+            continue;
+        if (chain_next.count(e.from) || chain_prev.count(e.to))
+            continue;
+        auto head = e.from;
+        while (chain_prev.count(head))
+            head = chain_prev[head];
+        if (head == e.to)
+            continue;
+        chain_next[e.from] = e.to;
+        chain_prev[e.to] = e.from;
+    }
+}
+// the entry chain first, then the chain most strongly reached from the placed blocks
+std::vector<BasicBlock *> EyrOptimizer::BlockLayout::orderChains(Function *fun) {
+    std::vector<BasicBlock *> order;
+    std::set<BasicBlock *> placed;
+    auto place = [&](BasicBlock *head) {
+        for (auto b = head; b; b = chain_next.count(b) ? chain_next[b] : nullptr)
+            order.push_back(b), placed.insert(b);
+    };
+    place(fun->entry);
+    while (order.size() < fun->blocks.size()) {
+        std::map<BasicBlock *, double> reach;
+        for (auto &e: edges) {
+            if (placed.count(e.from) && !placed.count(e.to)) {
+                auto head = e.to;
+                while (chain_prev.count(head))
+                    head = chain_prev[head];
+                reach[head] += e.weight;
+            }
+        }
+        BasicBlock *best = nullptr;
+        for (auto blk: fun->blocks) {
+            if (placed.count(blk) || chain_prev.count(blk))
+                continue;
+            if (!best || reach[blk] > reach[best])
+                best = blk;
+        }
+        place(best);
+    }
+    return order;
 }
-int EyrOptimizer::ConstFolder::getConst(Operand opr) {
-    return opr.imm ? opr.val : cur_consts[opr.var].val;
+// rebuilds fall/jump links so that only the next block in order is fallen into
+void EyrOptimizer::BlockLayout::relink(Function *fun, std::vector<BasicBlock *> order) {
+    std::map<BasicBlock *, BasicBlock *> taken, not_taken;
+    for (auto blk: order) {
+        auto last = blk->insts.empty() ? nullptr : blk->insts.back();
+        if (isa<BranchInst>(last)) {
+            taken[blk] = blk->jump_out, not_taken[blk] = blk->fall_out;
+        } else if (isa<JumpInst>(last)) {
+            not_taken[blk] = blk->jump_out;
+            last->remove();
+        } else {
+            not_taken[blk] = blk->fall_out;
+        }
+    }
+    for (auto blk: order)
+        blk->unfall(), blk->unjump();
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        auto blk = order[i];
+        auto next = i + 1 < order.size() ? order[i + 1] : nullptr;
+        auto t = taken[blk], f = not_taken[blk];
+        if (t) {
+            auto br = dyn_cast<BranchInst>(blk->insts.back());
+            if (t == next && f != next) {
+                br->opt = invert(br->opt);
+                br->dst = f;
+                std::swap(t, f);
+            } else if (f != next) {
+                // neither successor follows, fall into a new block jumping to f
+                auto tramp = fun->allocBlock();
+                not_taken[tramp] = f;
+                order.insert(order.begin() + i + 1, tramp);
+                f = tramp;
+            }
+            blk->jump(t);
+            blk->fall(f);
+        } else if (f == next && f) {
+            blk->fall(f);
+        } else if (f) {
+            blk->addInst(fun->module->make<JumpInst>(f));
+            blk->jump(f);
+        } else if (next && !endsWithReturn(blk)) {
+            // falling off the end of the function, which is no longer the last block
+            blk->addInst(fun->module->make<ReturnInst>(Operand(0)));
+        }
+    }
+    fun->blocks = order;
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i]->f_idx = i;
 }
+
 void EyrOptimizer::optimize(Module *mod) {
-    while (const_folder.optimize(mod));
+    inliner.optimize(mod);
+    tail_calls.optimize(mod);
+    SSAConstructor().construct(mod);
+    sccp.optimize(mod);
+    gvn.optimize(mod);
+    licm.optimize(mod);
+    reducer.optimize(mod);
+    fuser.optimize(mod);
+    SSADestructor().destruct(mod);
     while (simplifier.optimize(mod));
+    layout.optimize(mod);
+    tail_calls.mark(mod);
 }
 
 bool EyrOptimizer::Simplifier::optimize(Module *mod) {
@@ -305,34 +1243,22 @@ void EyrOptimizer::Simplifier::runOnBlock(BasicBlock *blk) {
     }
 }
 void EyrOptimizer::Simplifier::runOnInstruction(Instruction *ins) {
-#define MATCH(type) else if (auto i = dynamic_cast<type *>(ins)) { handle(i); }
-#define MATCHES MATCH(CallInst)MATCH(AssignInst)\
-MATCH(StoreInst)MATCH(BranchInst)MATCH(JumpInst)MATCH(ReturnInst)
-
     cur_ins = ins->prev();
-
-    if (false) {
-    } MATCHES
-    else {
-        assert(false);
-    }
-
-#undef MATCHES
-#undef MATCH
+    visit(ins);
 }
-void EyrOptimizer::Simplifier::handle(CallInst *ins) {
+void EyrOptimizer::Simplifier::visitCallInst(CallInst *ins) {
     updateLives(ins);
 }
-void EyrOptimizer::Simplifier::handle(StoreInst *ins) {
+void EyrOptimizer::Simplifier::visitStoreInst(StoreInst *ins) {
     updateLives(ins);
 }
-void EyrOptimizer::Simplifier::handle(BranchInst *ins) {
+void EyrOptimizer::Simplifier::visitBranchInst(BranchInst *ins) {
     updateLives(ins);
 }
-void EyrOptimizer::Simplifier::handle(JumpInst *ins) {
+void EyrOptimizer::Simplifier::visitJumpInst(JumpInst *ins) {
     updateLives(ins);
 }
-void EyrOptimizer::Simplifier::handle(ReturnInst *ins) {
+void EyrOptimizer::Simplifier::visitReturnInst(ReturnInst *ins) {
     updateLives(ins);
 }
 void EyrOptimizer::Simplifier::updateLives(Instruction *ins) {
@@ -341,7 +1267,7 @@ void EyrOptimizer::Simplifier::updateLives(Instruction *ins) {
     for (auto use: ins->uses())
         cur_lives.insert(use);
 }
-void EyrOptimizer::Simplifier::handle(AssignInst *ins) {
+void EyrOptimizer::Simplifier::visitAssignInst(AssignInst *ins) {
     if (cur_lives.count(ins->dst) == 0) {
         ins->remove();
         changed = true;
@@ -8,65 +8,251 @@
 #include "eyr.hh"
 #include <map>
 #include <set>
+#include <cstdint>
+#include <tuple>
 
 namespace mc {
 namespace eyr {
 
+class DominatorTree;
+struct Loop;
+
 class EyrOptimizer {
 public:
     void optimize(Module *mod);
 
 private:
-    class ConstFolder {
+    /*
+     * Inlines small non-recursive callees: blocks and variables are cloned
+     * into the caller, parameters become copies of the arguments (arrays
+     * are substituted) and returns jump to the block following the call.
+     */
+    class Inliner : public InstVisitor<Inliner, Instruction *> {
+        friend struct InstVisitor<Inliner, Instruction *>;
     public:
-        bool optimize(Module *mod);
+        void optimize(Module *mod);
+    private:
+
+        bool isRecursive(Function *fun);
+        bool shouldInline(Function *caller, Function *callee);
+        void inlineCall(CallInst *call, Function *callee);
+
+        // clone the callee's instructions, returns are left to inlineCall
+        Instruction *visitBinaryInst(BinaryInst *ins);
+        Instruction *visitUnaryInst(UnaryInst *ins);
+        Instruction *visitCallInst(CallInst *ins);
+        Instruction *visitMoveInst(MoveInst *ins);
+        Instruction *visitStoreInst(StoreInst *ins);
+        Instruction *visitLoadInst(LoadInst *ins);
+        Instruction *visitBranchInst(BranchInst *ins);
+        Instruction *visitJumpInst(JumpInst *ins);
+        Variable *mapVar(Variable *var);
+        Operand mapOpr(Operand opr);
+
+        Module *cur_mod{nullptr};
+        std::map<std::string, Function *> funcs;
+        std::map<Function *, std::set<Function *>> callees;
+        std::map<Function *, int> sizes, call_sites;
+        std::map<Variable *, Variable *> var_map;
+        std::map<BasicBlock *, BasicBlock *> blk_map;
+
+    } inliner;
+
+    /*
+     * A call returned right away is a tail call. Self-recursive ones become
+     * copies to the parameters and a jump back to the top of the function,
+     * before SSA construction; the others are marked for a "tail" jump at
+     * the end. Calls passing a local array keep their frame.
+     */
+    class TailCalls {
+    public:
+        void optimize(Module *mod);
+        void mark(Module *mod);
+    private:
+
+        void runOnFunction(Function *fun);
+        static ReturnInst *returnOf(CallInst *call);
+
+    } tail_calls;
+
+    /*
+     * Sparse conditional constant propagation (Wegman & Zadeck) over SSA
+     * form: constants and executable edges are discovered together in one
+     * worklist run, then uses are folded and dead edges removed.
+     */
+    class SCCP : public InstVisitor<SCCP> {
+        friend struct InstVisitor<SCCP>;
+    public:
+        void optimize(Module *mod);
     private:
 
-        struct MaybeConst {
+        struct LatticeVal {
+            enum Kind { UNDEF, CONST, OVERDEF } kind{UNDEF};
             int val{0};
-            bool is_const{false};
 
-            MaybeConst() = default;
-            MaybeConst(int val) : val(val), is_const(true) {}
+            LatticeVal() = default;
+            LatticeVal(Kind k) : kind(k) {}
+            LatticeVal(int val) : kind(CONST), val(val) {}
 
-            friend bool operator==(const MaybeConst &a, const MaybeConst &b) {
-                if (a.is_const && b.is_const)
-                    return a.val == b.val;
-                return a.is_const == b.is_const;
+            friend bool operator==(const LatticeVal &a, const LatticeVal &b) {
+                return a.kind == b.kind && (a.kind != CONST || a.val == b.val);
             }
-            friend bool operator!=(const MaybeConst &a, const MaybeConst &b) {
+            friend bool operator!=(const LatticeVal &a, const LatticeVal &b) {
                 return !(a == b);
             }
         };
+        using Edge = std::pair<BasicBlock *, BasicBlock *>;
 
         void runOnFunction(Function *fun);
-        void runOnBlock(BasicBlock *blk);
-        void runOnInstruction(Instruction *ins);
+        void forwardGlobalConsts(BasicBlock *blk);
+        void markEdge(BasicBlock *from, BasicBlock *to);
+        void visitBlock(BasicBlock *blk);
+        void visitPhiInst(PhiInst *phi);
+        void visitBinaryInst(BinaryInst *bin);
+        void visitUnaryInst(UnaryInst *un);
+        void visitMoveInst(MoveInst *mov);
+        void visitAssignInst(AssignInst *asg);
+        void visitBranchInst(BranchInst *ins);
+        void visitJumpInst(JumpInst *jmp);
+        void visitInstruction(Instruction *ins);
+        void setValue(Variable *var, LatticeVal val);
+        void rewrite(BasicBlock *blk);
+        void foldBranch(BranchInst *ins, bool taken);
 
-        void handle(BinaryInst *ins);
-        void handle(UnaryInst *ins);
-        void handle(CallInst *ins);
-        void handle(MoveInst *ins);
-        void handle(StoreInst *ins);
-        void handle(LoadInst *ins);
-        void handle(BranchInst *ins);
-        void handle(JumpInst *ins);
-        void handle(ReturnInst *ins);
-
-        bool isConst(Operand opr);
-        int getConst(Operand opr);
-
-        using ConstTable = std::map<Variable *, MaybeConst>;
-        std::map<BasicBlock *, ConstTable> in_consts, out_consts;
-        std::set<BasicBlock *> work_list;
-        ConstTable cur_consts;
-        bool rewrite{false};
-        Instruction *cur_ins{nullptr};
-        bool flow_changed{false}; // 是否改变了控制流
+        LatticeVal valueOf(Operand opr);
+        static LatticeVal meet(LatticeVal a, LatticeVal b);
+        static LatticeVal evalBinary(BinaryInst::BinOp op, LatticeVal l, LatticeVal r);
+
+        std::map<Variable *, LatticeVal> values;
+        std::map<Variable *, std::vector<Instruction *>> users;
+        std::set<Edge> exec_edges;
+        std::set<BasicBlock *> exec_blocks;
+        std::vector<Edge> flow_work;
+        std::vector<Instruction *> ssa_work;
+
+    } sccp;
+
+    /*
+     * Dominator-based value numbering over SSA form: copies are propagated,
+     * BinaryInst/UnaryInst with an available equal expression are removed.
+     * Loads are reused along extended basic blocks until a store may
+     * overwrite them or a call happens, stores forward their value.
+     */
+    class GVN {
+    public:
+        void optimize(Module *mod);
+    private:
+
+        // kind, operator, then both operands as (is immediate, value or variable)
+        using Key = std::tuple<int, int, bool, intptr_t, bool, intptr_t>;
+        using KeyTable = std::map<Key, Operand>;
+
+        void runOnFunction(Function *fun);
+        void runOnBlock(BasicBlock *blk, KeyTable loads);
+        bool numberInst(Instruction *ins, KeyTable &loads, std::vector<Key> &scope);
+        void killLoads(KeyTable &loads, Variable *base);
+
+        Operand leaderOf(Operand opr);
+        static Key makeKey(int kind, int opt, Operand l, Operand r);
+
+        DominatorTree *dom_tree{nullptr};
+        std::map<Variable *, Operand> leaders;
+        KeyTable exprs;
+
+    } gvn;
+
+    /*
+     * Loop-invariant code motion over SSA form. Every natural loop first
+     * gets a preheader, then invariant BinaryInst/UnaryInst/MoveInst and
+     * loads no store or call in the loop may overwrite move there,
+     * innermost loops first.
+     */
+    class LICM {
+    public:
+        void optimize(Module *mod);
+    private:
+
+        void runOnFunction(Function *fun);
+        void insertPreheader(const Loop &loop);
+        void hoist(const Loop &loop, const DominatorTree &dom_tree);
+        bool canHoist(Instruction *ins, bool always_runs);
+        bool isInvariant(Operand opr);
+        bool mayBeStored(Variable *base);
+
+        Function *cur_func{nullptr};
+        std::set<Variable *> loop_defs; // renamed and global variables defined in the loop
+        std::vector<Variable *> stored_bases;
+        bool has_call{false};
+
+    } licm;
+
+    /*
+     * Induction variable strength reduction over SSA form: for a basic
+     * induction variable i = phi(init, i + c), every product i * k in the
+     * loop is replaced by a new induction variable stepping by c * k, so
+     * array offsets advance by an addition per iteration.
+     */
+    class StrengthReducer {
+    public:
+        void optimize(Module *mod);
+    private:
+
+        void runOnFunction(Function *fun);
+        void runOnLoop(const Loop &loop);
+        BinaryInst *stepOf(PhiInst *phi, BasicBlock *latch, int &step);
+
+        Function *cur_func{nullptr};
+        std::map<Variable *, Instruction *> def_of;
+        std::map<Variable *, std::vector<Instruction *>> users;
+
+    } reducer;
+
+    /*
+     * Folds a single-use comparison (or its negation) computed in the same
+     * block into the conditional branch testing it, so no boolean is
+     * materialized: t = a < b; if t != 0 goto l  becomes  if a < b goto l.
+     */
+    class BranchFuser {
+    public:
+        void optimize(Module *mod);
+    private:
+
+        void runOnFunction(Function *fun);
+        bool fuse(BranchInst *br);
+
+        std::map<Variable *, int> use_count;
+
+    } fuser;
+
+    /*
+     * Pettis & Hansen block placement: edges are weighted by static branch
+     * probabilities (loop back edges and exits, branches to returns) scaled
+     * by loop depth, the heaviest edges become fall-throughs, then branches
+     * are inverted and jumps added or dropped to match the new order.
+     */
+    class BlockLayout {
+    public:
+        void optimize(Module *mod);
+    private:
+
+        struct Edge {
+            BasicBlock *from, *to;
+            double weight;
+        };
+
+        void runOnFunction(Function *fun);
+        void weighEdges(Function *fun);
+        void buildChains();
+        std::vector<BasicBlock *> orderChains(Function *fun);
+        void relink(Function *fun, std::vector<BasicBlock *> order);
+
+        std::vector<Edge> edges;
+        std::map<BasicBlock *, BasicBlock *> chain_next, chain_prev;
 
-    } const_folder;
+    } layout;
 
-    class Simplifier {
+    class Simplifier : public InstVisitor<Simplifier> {
+        friend struct InstVisitor<Simplifier>;
     public:
         bool optimize(Module *mod);
     private:
@@ -75,12 +261,12 @@ private:
         void runOnBlock(BasicBlock *blk);
         void runOnInstruction(Instruction *ins);
 
-        void handle(AssignInst *ins);
-        void handle(CallInst *ins);
-        void handle(StoreInst *ins);
-        void handle(BranchInst *ins);
-        void handle(JumpInst *ins);
-        void handle(ReturnInst *ins);
+        void visitAssignInst(AssignInst *ins);
+        void visitCallInst(CallInst *ins);
+        void visitStoreInst(StoreInst *ins);
+        void visitBranchInst(BranchInst *ins);
+        void visitJumpInst(JumpInst *ins);
+        void visitReturnInst(ReturnInst *ins);
         void updateLives(Instruction *ins);
 
         using VarSet = std::set<Variable *>;
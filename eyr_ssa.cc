@@ -0,0 +1,545 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#include "eyr_ssa.hh"
+#include <algorithm>
+
+namespace mc {
+namespace eyr {
+
+static std::vector<PhiInst *> phisOf(BasicBlock *blk) {
+    std::vector<PhiInst *> res;
+    for (auto inst: blk->insts) {
+        auto phi = dyn_cast<PhiInst>(inst);
+        if (!phi)
+            break;
+        res.push_back(phi);
+    }
+    return res;
+}
+// a block may both fall and jump to the same successor
+static std::vector<BasicBlock *> uniqueBlocks(std::vector<BasicBlock *> blks) {
+    std::vector<BasicBlock *> res;
+    for (auto b: blks) {
+        if (std::find(res.begin(), res.end(), b) == res.end())
+            res.push_back(b);
+    }
+    return res;
+}
+
+DominatorTree::DominatorTree(Function *fun) {
+    int n = fun->blocks.size();
+    for (int i = 0; i < n; ++i)
+        assert(fun->blocks[i]->f_idx == i);
+    rpo_idx.assign(n, -1), idoms.assign(n, nullptr);
+    kids.assign(n, {}), df.assign(n, {});
+    pre.assign(n, -1), post.assign(n, -1);
+
+    std::vector<bool> seen(n, false);
+    std::vector<std::pair<BasicBlock *, size_t>> stk{{fun->entry, 0}};
+    seen[fun->entry->f_idx] = true;
+    while (!stk.empty()) {
+        auto &top = stk.back();
+        auto outs = top.first->outBlocks();
+        if (top.second < outs.size()) {
+            auto succ = outs[top.second++];
+            if (!seen[succ->f_idx])
+                seen[succ->f_idx] = true, stk.push_back({succ, 0});
+        } else {
+            order.push_back(top.first);
+            stk.pop_back();
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); ++i)
+        rpo_idx[order[i]->f_idx] = i;
+
+    auto entry = fun->entry;
+    idoms[entry->f_idx] = entry;
+    bool changed;
+    do {
+        changed = false;
+        for (auto blk: order) {
+            if (blk == entry)
+                continue;
+            BasicBlock *new_idom = nullptr;
+            for (auto pred: blk->inBlocks()) {
+                if (!reachable(pred) || !idoms[pred->f_idx])
+                    continue;
+                new_idom = new_idom ? intersect(pred, new_idom) : pred;
+            }
+            if (idoms[blk->f_idx] != new_idom)
+                idoms[blk->f_idx] = new_idom, changed = true;
+        }
+    } while (changed);
+
+    for (auto blk: order) {
+        std::vector<BasicBlock *> preds;
+        for (auto pred: uniqueBlocks(blk->inBlocks())) {
+            if (reachable(pred))
+                preds.push_back(pred);
+        }
+        if (preds.size() < 2)
+            continue;
+        for (auto runner: preds) {
+            while (runner != idoms[blk->f_idx]) {
+                df[runner->f_idx].insert(blk);
+                runner = idoms[runner->f_idx];
+            }
+        }
+    }
+    idoms[entry->f_idx] = nullptr;
+    for (auto blk: order) {
+        if (blk != entry)
+            kids[idoms[blk->f_idx]->f_idx].push_back(blk);
+    }
+
+    int cnt = 0;
+    std::vector<std::pair<BasicBlock *, size_t>> walk{{entry, 0}};
+    pre[entry->f_idx] = cnt++;
+    while (!walk.empty()) {
+        auto &top = walk.back();
+        auto &cs = kids[top.first->f_idx];
+        if (top.second < cs.size()) {
+            auto c = cs[top.second++];
+            pre[c->f_idx] = cnt++;
+            walk.push_back({c, 0});
+        } else {
+            post[top.first->f_idx] = cnt++;
+            walk.pop_back();
+        }
+    }
+}
+BasicBlock *DominatorTree::intersect(BasicBlock *a, BasicBlock *b) const {
+    while (a != b) {
+        while (rpo_idx[a->f_idx] > rpo_idx[b->f_idx])
+            a = idoms[a->f_idx];
+        while (rpo_idx[b->f_idx] > rpo_idx[a->f_idx])
+            b = idoms[b->f_idx];
+    }
+    return a;
+}
+bool DominatorTree::dominates(BasicBlock *a, BasicBlock *b) const {
+    if (!reachable(a) || !reachable(b))
+        return false;
+    return pre[a->f_idx] <= pre[b->f_idx] && post[b->f_idx] <= post[a->f_idx];
+}
+
+std::vector<Loop> findLoops(const DominatorTree &dom_tree) {
+    std::vector<Loop> loops;
+    std::map<BasicBlock *, size_t> loop_of;
+    for (auto blk: dom_tree.rpo()) {
+        for (auto succ: uniqueBlocks(blk->outBlocks())) {
+            if (!dom_tree.dominates(succ, blk))
+                continue;
+            if (loop_of.count(succ) == 0) {
+                loop_of[succ] = loops.size();
+                loops.push_back({succ, {succ}});
+            }
+            auto &body = loops[loop_of[succ]].blocks;
+            std::vector<BasicBlock *> work{blk};
+            while (!work.empty()) {
+                auto b = work.back();
+                work.pop_back();
+                if (!body.insert(b).second)
+                    continue;
+                for (auto pred: b->inBlocks()) {
+                    if (dom_tree.reachable(pred))
+                        work.push_back(pred);
+                }
+            }
+        }
+    }
+    std::stable_sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b) {
+        return a.blocks.size() < b.blocks.size();
+    });
+    return loops;
+}
+
+Liveness::Liveness(Function *fun) {
+    std::map<BasicBlock *, std::set<Variable *>> gen, kill, phi_uses;
+    for (auto blk: fun->blocks) {
+        auto &g = gen[blk], &k = kill[blk];
+        for (auto inst: blk->insts) {
+            if (auto phi = dyn_cast<PhiInst>(inst)) {
+                for (auto &src: phi->srcs) {
+                    if (!src.second.imm && isSSAVar(src.second.var))
+                        phi_uses[src.first].insert(src.second.var);
+                }
+            } else {
+                for (auto use: inst->uses()) {
+                    if (isSSAVar(use) && k.count(use) == 0)
+                        g.insert(use);
+                }
+            }
+            for (auto def: inst->defs()) {
+                if (isSSAVar(def))
+                    k.insert(def);
+            }
+        }
+        live_in[blk], live_out[blk];
+    }
+    bool changed;
+    do {
+        changed = false;
+        for (BasicBlock *blk: reverse(fun->blocks)) {
+            auto out = phi_uses[blk];
+            for (auto succ: blk->outBlocks())
+                out.insert(live_in[succ].begin(), live_in[succ].end());
+            auto in = gen[blk];
+            for (auto var: out) {
+                if (kill[blk].count(var) == 0)
+                    in.insert(var);
+            }
+            if (in != live_in[blk] || out != live_out[blk])
+                changed = true;
+            live_in[blk].swap(in), live_out[blk].swap(out);
+        }
+    } while (changed);
+}
+
+void SSAConstructor::construct(Module *mod) {
+    for (auto fun: mod->global_funcs)
+        runOnFunction(fun);
+}
+void SSAConstructor::runOnFunction(Function *fun) {
+    cur_func = fun;
+    DominatorTree dt(fun);
+    dom_tree = &dt;
+    phi_var.clear(), stacks.clear();
+
+    insertPhis();
+    rename(fun->entry);
+    dom_tree = nullptr;
+}
+void SSAConstructor::insertPhis() {
+    Liveness live(cur_func);
+    std::vector<Variable *> vars; // in order of appearance, to stay deterministic
+    std::map<Variable *, std::set<BasicBlock *>> def_blks;
+    for (auto blk: cur_func->blocks) {
+        for (auto inst: blk->insts) {
+            for (auto def: inst->defs()) {
+                if (!isSSAVar(def))
+                    continue;
+                auto &blks = def_blks[def];
+                if (blks.empty())
+                    vars.push_back(def);
+                blks.insert(blk);
+            }
+        }
+    }
+    for (auto var: vars) {
+        auto &blks = def_blks[var];
+        std::vector<BasicBlock *> work(blks.begin(), blks.end());
+        std::set<BasicBlock *> has_phi;
+        while (!work.empty()) {
+            auto blk = work.back();
+            work.pop_back();
+            for (auto d: dom_tree->frontier(blk)) {
+                if (has_phi.count(d) || live.live_in[d].count(var) == 0)
+                    continue;
+                has_phi.insert(d);
+                auto phi = cur_func->module->make<PhiInst>(var);
+                for (auto pred: uniqueBlocks(d->inBlocks()))
+                    phi->srcs.push_back({pred, Operand(var)});
+                if (d->insts.empty())
+                    d->addInst(phi);
+                else
+                    d->insts.front()->addBefore(phi);
+                phi_var[phi] = var;
+                if (blks.count(d) == 0)
+                    work.push_back(d);
+            }
+        }
+    }
+}
+Variable *SSAConstructor::top(Variable *var) {
+    auto it = stacks.find(var);
+    return it == stacks.end() || it->second.empty() ? var : it->second.back();
+}
+void SSAConstructor::rename(BasicBlock *blk) {
+    std::vector<Variable *> pushed;
+    for (auto inst: blk->insts) {
+        auto phi = dyn_cast<PhiInst>(inst);
+        if (!phi) {
+            for (auto use: inst->uses()) {
+                if (isSSAVar(use) && top(use) != use)
+                    inst->replaceUse(use, Operand(top(use)));
+            }
+        }
+        auto asg = dyn_cast<AssignInst>(inst);
+        if (asg && isSSAVar(asg->dst)) {
+            auto orig = phi ? phi_var[phi] : asg->dst;
+            auto ver = cur_func->allocLocalVar();
+            stacks[orig].push_back(ver);
+            pushed.push_back(orig);
+            asg->dst = ver;
+        }
+    }
+    for (auto succ: uniqueBlocks(blk->outBlocks())) {
+        for (auto phi: phisOf(succ))
+            phi->srcOf(blk) = Operand(top(phi_var[phi]));
+    }
+    for (auto c: dom_tree->children(blk))
+        rename(c);
+    for (auto var: pushed)
+        stacks[var].pop_back();
+}
+
+void SSADestructor::destruct(Module *mod) {
+    for (auto fun: mod->global_funcs)
+        runOnFunction(fun);
+}
+void SSADestructor::runOnFunction(Function *fun) {
+    cur_func = fun;
+    adj.clear(), parent.clear(), members.clear(), reps.clear();
+
+    buildInterference();
+    coalescePhis();
+    insertCopies();
+    renameToRepresentatives();
+    removeUnusedVars();
+    fun->arrangeBlock();
+}
+void SSADestructor::buildInterference() {
+    auto add_edge = [this](Variable *a, Variable *b) {
+        if (a != b)
+            adj[a].insert(b), adj[b].insert(a);
+    };
+    Liveness live(cur_func);
+    for (auto blk: cur_func->blocks) {
+        auto cur_live = live.live_out[blk];
+        std::vector<Variable *> phi_defs;
+        for (Instruction *inst: reverse(blk->insts)) {
+            if (isa<PhiInst>(inst)) {
+                phi_defs.push_back(static_cast<PhiInst *>(inst)->dst);
+                continue;
+            }
+            for (auto def: inst->defs()) {
+                if (!isSSAVar(def))
+                    continue;
+                for (auto var: cur_live)
+                    add_edge(var, def);
+                cur_live.erase(def);
+            }
+            for (auto use: inst->uses()) {
+                if (isSSAVar(use))
+                    cur_live.insert(use);
+            }
+        }
+        // phis define their results simultaneously at the block entry
+        for (auto def: phi_defs)
+            cur_live.erase(def);
+        for (auto def: phi_defs) {
+            for (auto var: cur_live)
+                add_edge(var, def);
+            for (auto other: phi_defs)
+                add_edge(other, def);
+        }
+        if (blk == cur_func->entry) {
+            // parameters and uninitialized variables are all defined at the entry
+            std::vector<Variable *> defs(cur_live.begin(), cur_live.end());
+            defs.insert(defs.end(), cur_func->params.begin(), cur_func->params.end());
+            for (auto a: defs) {
+                for (auto b: defs)
+                    add_edge(a, b);
+            }
+        }
+    }
+}
+Variable *SSADestructor::find(Variable *var) {
+    auto it = parent.find(var);
+    while (it != parent.end() && it->second != var) {
+        var = it->second;
+        it = parent.find(var);
+    }
+    return var;
+}
+bool SSADestructor::interfere(Variable *a, Variable *b) {
+    auto ma = members.count(a) ? members[a] : std::vector<Variable *>{a};
+    auto mb = members.count(b) ? members[b] : std::vector<Variable *>{b};
+    for (auto x: ma) {
+        auto it = adj.find(x);
+        if (it == adj.end())
+            continue;
+        for (auto y: mb) {
+            if (it->second.count(y))
+                return true;
+        }
+    }
+    return false;
+}
+void SSADestructor::coalescePhis() {
+    for (auto blk: cur_func->blocks) {
+        for (auto phi: phisOf(blk)) {
+            for (auto &src: phi->srcs) {
+                if (src.second.imm || !isSSAVar(src.second.var))
+                    continue;
+                auto rx = find(phi->dst), ra = find(src.second.var);
+                if (rx == ra || interfere(rx, ra))
+                    continue;
+                if (!members.count(rx))
+                    members[rx] = {rx};
+                if (!members.count(ra))
+                    members[ra] = {ra};
+                if (members[rx].size() < members[ra].size())
+                    std::swap(rx, ra);
+                parent[ra] = rx;
+                members[rx].insert(members[rx].end(), members[ra].begin(), members[ra].end());
+                members.erase(ra);
+            }
+        }
+    }
+    // a parameter keeps its name since it is defined by the call
+    for (auto &p: members) {
+        auto rep = p.first;
+        for (auto var: p.second) {
+            if (var->is_param() || (!var->is_temp() && !rep->is_param()))
+                rep = var;
+        }
+        reps[p.first] = rep;
+    }
+}
+Variable *SSADestructor::repOf(Variable *var) {
+    if (!isSSAVar(var))
+        return var;
+    auto root = find(var);
+    auto it = reps.find(root);
+    return it == reps.end() ? root : it->second;
+}
+void SSADestructor::insertCopies() {
+    auto blocks = cur_func->blocks;
+    for (auto blk: blocks) {
+        auto phis = phisOf(blk);
+        if (phis.empty())
+            continue;
+        std::vector<std::pair<BasicBlock *, std::vector<std::pair<Variable *, Operand>>>> edges;
+        for (auto pred: uniqueBlocks(blk->inBlocks())) {
+            std::vector<std::pair<Variable *, Operand>> copies;
+            for (auto phi: phis) {
+                auto dst = repOf(phi->dst);
+                auto src = phi->srcOf(pred);
+                if (!src.imm)
+                    src = Operand(repOf(src.var));
+                if (src.imm || src.var != dst)
+                    copies.push_back({dst, src});
+            }
+            if (!copies.empty())
+                edges.push_back({pred, copies});
+        }
+        for (auto phi: phis)
+            blk->removeInst(phi);
+
+        for (auto &e: edges) {
+            auto pred = e.first;
+            auto outs = pred->outBlocks();
+            if (outs.size() == 1) {
+                std::vector<Instruction *> seq;
+                sequentialize(e.second, seq);
+                auto last = pred->insts.empty() ? nullptr : pred->insts.back();
+                for (auto inst: seq) {
+                    if (last && isa<JumpInst>(last))
+                        last->addBefore(inst);
+                    else
+                        pred->addInst(inst);
+                }
+                continue;
+            }
+            // critical edge: the copies get a block of their own
+            for (size_t k = 0; k < outs.size(); ++k) {
+                if (outs[k] != blk)
+                    continue;
+                bool is_fall = k == 0 && pred->fall_out;
+                auto mid = cur_func->allocBlock();
+                std::vector<Instruction *> seq;
+                sequentialize(e.second, seq);
+                for (auto inst: seq)
+                    mid->addInst(inst);
+                if (is_fall) {
+                    pred->unfall();
+                    pred->fall(mid);
+                    mid->fall(blk);
+                } else {
+                    auto br = dyn_cast<JumpInst>(pred->insts.back());
+                    assert(br && br->dst == blk);
+                    br->dst = mid;
+                    pred->unjump();
+                    pred->jump(mid);
+                    mid->addInst(cur_func->module->make<JumpInst>(blk));
+                    mid->jump(blk);
+                }
+            }
+        }
+    }
+}
+void SSADestructor::sequentialize(std::vector<std::pair<Variable *, Operand>> copies,
+                                  std::vector<Instruction *> &out) {
+    // emit a copy once no other pending copy reads its destination,
+    // break cycles with a temporary
+    while (!copies.empty()) {
+        size_t i = 0;
+        for (; i < copies.size(); ++i) {
+            bool blocked = false;
+            for (size_t j = 0; j < copies.size(); ++j) {
+                auto &src = copies[j].second;
+                if (j != i && !src.imm && src.var == copies[i].first)
+                    blocked = true;
+            }
+            if (!blocked)
+                break;
+        }
+        if (i == copies.size()) {
+            auto dst = copies[0].first;
+            auto tmp = cur_func->allocLocalVar();
+            out.push_back(cur_func->module->make<MoveInst>(tmp, Operand(dst)));
+            for (auto &c: copies) {
+                if (!c.second.imm && c.second.var == dst)
+                    c.second = Operand(tmp);
+            }
+            i = 0;
+        }
+        out.push_back(cur_func->module->make<MoveInst>(copies[i].first, copies[i].second));
+        copies.erase(copies.begin() + i);
+    }
+}
+void SSADestructor::renameToRepresentatives() {
+    for (auto blk: cur_func->blocks) {
+        auto inst = blk->insts.empty() ? nullptr : blk->insts.front();
+        while (inst) {
+            auto next = inst->next();
+            for (auto use: inst->uses()) {
+                auto rep = repOf(use);
+                if (rep != use)
+                    inst->replaceUse(use, Operand(rep));
+            }
+            if (auto asg = dyn_cast<AssignInst>(inst))
+                asg->dst = repOf(asg->dst);
+            auto mov = dyn_cast<MoveInst>(inst);
+            if (mov && !mov->src.imm && mov->src.var == mov->dst) {
+                mov->remove();
+            }
+            inst = next;
+        }
+    }
+}
+void SSADestructor::removeUnusedVars() {
+    std::set<Variable *> used;
+    for (auto blk: cur_func->blocks) {
+        for (auto inst: blk->insts) {
+            for (auto var: inst->uses())
+                used.insert(var);
+            for (auto var: inst->defs())
+                used.insert(var);
+        }
+    }
+    std::vector<Variable *> vars;
+    for (auto var: cur_func->local_vars) {
+        if (var->is_addr() || used.count(var))
+            vars.push_back(var);
+    }
+    cur_func->local_vars.swap(vars);
+}
+
+}
+}
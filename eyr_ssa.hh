@@ -0,0 +1,121 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#ifndef __MC_EYR_SSA_HH__
+#define __MC_EYR_SSA_HH__
+
+#include "eyr.hh"
+#include <map>
+#include <set>
+#include <vector>
+
+namespace mc {
+namespace eyr {
+
+// only local scalars are renamed; globals and arrays stay in memory
+static inline bool isSSAVar(Variable *var) {
+    return var->is_local() && !var->is_addr();
+}
+
+/*
+ * Dominator tree (Cooper, Harvey & Kennedy) and dominance frontiers.
+ * Expects f_idx to be the index of the block in its function, i.e. the
+ * function has been arranged.
+ */
+class DominatorTree {
+public:
+    explicit DominatorTree(Function *fun);
+
+    BasicBlock *idom(BasicBlock *blk) const { return idoms[blk->f_idx]; }
+    const std::vector<BasicBlock *> &children(BasicBlock *blk) const { return kids[blk->f_idx]; }
+    const std::set<BasicBlock *> &frontier(BasicBlock *blk) const { return df[blk->f_idx]; }
+    const std::vector<BasicBlock *> &rpo() const { return order; }
+    bool reachable(BasicBlock *blk) const { return rpo_idx[blk->f_idx] >= 0; }
+    bool dominates(BasicBlock *a, BasicBlock *b) const;
+
+private:
+    std::vector<BasicBlock *> order; // reverse post order of the reachable blocks
+    std::vector<int> rpo_idx;
+    std::vector<BasicBlock *> idoms;
+    std::vector<std::vector<BasicBlock *>> kids;
+    std::vector<std::set<BasicBlock *>> df;
+    std::vector<int> pre, post; // tree numbering for dominates()
+
+    BasicBlock *intersect(BasicBlock *a, BasicBlock *b) const;
+};
+
+// natural loop of the back edges into header
+struct Loop {
+    BasicBlock *header;
+    std::set<BasicBlock *> blocks;
+};
+// innermost loops first
+std::vector<Loop> findLoops(const DominatorTree &dom_tree);
+
+/*
+ * Live variables (isSSAVar only) at block boundaries, with the uses of a phi
+ * counted at the end of the corresponding predecessor.
+ */
+struct Liveness {
+    std::map<BasicBlock *, std::set<Variable *>> live_in, live_out;
+
+    explicit Liveness(Function *fun);
+};
+
+/*
+ * Builds pruned SSA: phis at the iterated dominance frontier of the
+ * definitions where the variable is live, then renaming along the dominator
+ * tree. Every definition gets a fresh temporary; a use without reaching
+ * definition keeps the original variable (parameters, uninitialized locals).
+ */
+class SSAConstructor {
+public:
+    void construct(Module *mod);
+
+private:
+    void runOnFunction(Function *fun);
+    void insertPhis();
+    void rename(BasicBlock *blk);
+    Variable *top(Variable *var);
+
+    Function *cur_func{nullptr};
+    DominatorTree *dom_tree{nullptr};
+    std::map<PhiInst *, Variable *> phi_var;
+    std::map<Variable *, std::vector<Variable *>> stacks;
+};
+
+/*
+ * Leaves SSA form: phi-related variables whose live ranges do not interfere
+ * are merged into one variable, the remaining phi operands become parallel
+ * copies on the incoming edges (critical edges are split).
+ */
+class SSADestructor {
+public:
+    void destruct(Module *mod);
+
+private:
+    void runOnFunction(Function *fun);
+    void buildInterference();
+    void coalescePhis();
+    void insertCopies();
+    void renameToRepresentatives();
+    void removeUnusedVars();
+
+    Variable *find(Variable *var);
+    Variable *repOf(Variable *var);
+    bool interfere(Variable *a, Variable *b);
+    void sequentialize(std::vector<std::pair<Variable *, Operand>> copies,
+                       std::vector<Instruction *> &out);
+
+    Function *cur_func{nullptr};
+    std::map<Variable *, std::set<Variable *>> adj;
+    std::map<Variable *, Variable *> parent;
+    std::map<Variable *, std::vector<Variable *>> members;
+    std::map<Variable *, Variable *> reps; // class root -> variable naming the class
+};
+
+}
+}
+
+#endif //__MC_EYR_SSA_HH__
@@ -0,0 +1,97 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#ifndef __MC_ILIST_HH__
+#define __MC_ILIST_HH__
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+
+namespace mc {
+
+// links embedded in the elements of an IList
+template<typename T>
+struct IListNode {
+    T *ilist_prev{nullptr};
+    T *ilist_next{nullptr};
+};
+
+/*
+ * Intrusive doubly-linked list of T *, T deriving from IListNode<T>.
+ * The list owns no memory: inserting and erasing only relink the
+ * elements, and an element is in at most one list at a time.
+ */
+template<typename T>
+class IList {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T *;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T *const *;
+        using reference = T *;
+
+        iterator() = default;
+        iterator(const IList *l, T *n) : list(l), node(n) {}
+        T *operator*() const { return node; }
+        iterator &operator++() { return node = node->ilist_next, *this; }
+        iterator &operator--() { return node = node ? node->ilist_prev : list->tail, *this; }
+        iterator operator++(int) {
+            auto it = *this;
+            return ++*this, it;
+        }
+        iterator operator--(int) {
+            auto it = *this;
+            return --*this, it;
+        }
+        bool operator==(const iterator &o) const { return node == o.node; }
+        bool operator!=(const iterator &o) const { return node != o.node; }
+
+    private:
+        const IList *list{nullptr};
+        T *node{nullptr};
+    };
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    IList() = default;
+    IList(const IList &) = delete;
+    IList &operator=(const IList &) = delete;
+
+    bool empty() const { return head == nullptr; }
+    size_t size() const { return count; }
+    // null if the list is empty
+    T *front() const { return head; }
+    T *back() const { return tail; }
+    iterator begin() const { return {this, head}; }
+    iterator end() const { return {this, nullptr}; }
+    reverse_iterator rbegin() const { return reverse_iterator(end()); }
+    reverse_iterator rend() const { return reverse_iterator(begin()); }
+
+    // inserts x before pos, at the end if pos is null
+    void insert(T *pos, T *x) {
+        assert(!x->ilist_prev && !x->ilist_next && head != x);
+        auto prev = pos ? pos->ilist_prev : tail;
+        x->ilist_prev = prev, x->ilist_next = pos;
+        (prev ? prev->ilist_next : head) = x;
+        (pos ? pos->ilist_prev : tail) = x;
+        ++count;
+    }
+    void push_back(T *x) { insert(nullptr, x); }
+    void erase(T *x) {
+        (x->ilist_prev ? x->ilist_prev->ilist_next : head) = x->ilist_next;
+        (x->ilist_next ? x->ilist_next->ilist_prev : tail) = x->ilist_prev;
+        x->ilist_prev = x->ilist_next = nullptr;
+        --count;
+    }
+
+private:
+    T *head{nullptr}, *tail{nullptr};
+    size_t count{0};
+};
+
+}
+
+#endif //__MC_ILIST_HH__
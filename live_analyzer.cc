@@ -3,6 +3,8 @@
 //
 
 #include "live_analyzer.hh"
+#include <deque>
+#include <map>
 
 namespace mc {
 namespace tgr {
@@ -12,55 +14,107 @@ void LiveAnalyzer::analyze(Module *mod) {
     for (auto func: mod->funcs)
         globalAnalyze(func);
 }
-void LiveAnalyzer::localAnalyze(BasicBlock *blk) {
-    blk->live_gen.clear(), blk->live_kill.clear();
+void LiveAnalyzer::localAnalyze(BasicBlock *blk, Word *gen, Word *kill) {
     for (auto op: blk->ops) {
         for (auto use: op->getUsedVirRegs()) {
-            if (blk->live_kill.count(use) == 0)
-                blk->live_gen.insert(use);
+            if (!(kill[use / 64] >> (use % 64) & 1))
+                gen[use / 64] |= Word(1) << (use % 64);
         }
         for (auto def: op->getDefinedVirRegs()) {
-            blk->live_kill.insert(def);
+            kill[def / 64] |= Word(1) << (def % 64);
         }
     }
 }
 void LiveAnalyzer::globalAnalyze(Function *func) {
-    for (auto blk: func->blocks) {
-        localAnalyze(blk);
-        blk->live_in.clear(), blk->live_out.clear();
+    auto order = postOrder(func);
+    int n = order.size();
+    int words = (func->module->next_vir_reg_id + 63) / 64;
+    std::map<BasicBlock *, int> index;
+    for (int i = 0; i < n; ++i)
+        index[order[i]] = i;
+    std::vector<std::vector<int>> succs(n), preds(n);
+    for (int i = 0; i < n; ++i) {
+        for (auto sux: order[i]->outBlocks()) {
+            succs[i].push_back(index[sux]);
+            preds[index[sux]].push_back(i);
+        }
     }
-    bool stop;
-    do {
-        stop = true;
-        for (auto blk: func->blocks) {
-            for (auto sux: blk->outBlocks()) {
-                for (auto reg: sux->live_in)
-                    blk->live_out.insert(reg);
-            }
-            auto old = blk->live_in;
-            blk->live_in = blk->live_out;
-            for (auto reg: blk->live_kill)
-                blk->live_in.erase(reg);
-            for (auto reg: blk->live_gen)
-                blk->live_in.insert(reg);
-            if (old != blk->live_in)
-                stop = false;
+
+    // gen, kill, in and out of block i, one after another
+    std::vector<Word> bits(size_t(n) * 4 * words, 0);
+    auto gen = [&](int i) { return &bits[(size_t(i) * 4 + 0) * words]; };
+    auto kill = [&](int i) { return &bits[(size_t(i) * 4 + 1) * words]; };
+    auto in = [&](int i) { return &bits[(size_t(i) * 4 + 2) * words]; };
+    auto out = [&](int i) { return &bits[(size_t(i) * 4 + 3) * words]; };
+    for (int i = 0; i < n; ++i)
+        localAnalyze(order[i], gen(i), kill(i));
+
+    // successors first, a block is queued again when the live-in of one changes
+    std::deque<int> worklist;
+    for (int i = 0; i < n; ++i)
+        worklist.push_back(i);
+    std::vector<bool> queued(n, true);
+    while (!worklist.empty()) {
+        int i = worklist.front();
+        worklist.pop_front();
+        queued[i] = false;
+        auto o = out(i), g = gen(i), k = kill(i), li = in(i);
+        for (int s: succs[i]) {
+            auto si = in(s);
+            for (int w = 0; w < words; ++w)
+                o[w] |= si[w];
         }
-    } while (!stop);
+        bool changed = false;
+        for (int w = 0; w < words; ++w) {
+            Word v = g[w] | (o[w] & ~k[w]);
+            changed = changed || v != li[w];
+            li[w] = v;
+        }
+        if (!changed)
+            continue;
+        for (int p: preds[i]) {
+            if (!queued[p])
+                queued[p] = true, worklist.push_back(p);
+        }
+    }
 
-//    for (auto blk: func->blocks) {
-//        std::cerr << blk->label << ": ";
-//        std::cerr << "live-in[";
-//        for (auto reg: blk->live_in)
-//            std::cerr << reg << ", ";
-//        std::cerr << "], ";
-//        std::cerr << "live-out[";
-//        for (auto reg: blk->live_out)
-//            std::cerr << reg << ", ";
-//        std::cerr << "]" << std::endl;
-//    }
+    for (int i = 0; i < n; ++i) {
+        toSet(in(i), words, order[i]->live_in);
+        toSet(out(i), words, order[i]->live_out);
+    }
+}
+std::vector<BasicBlock *> LiveAnalyzer::postOrder(Function *func) {
+    std::vector<BasicBlock *> order;
+    std::set<BasicBlock *> visited;
+    std::vector<std::pair<BasicBlock *, size_t>> stack;
+    for (auto root: func->blocks) {
+        if (!visited.insert(root).second)
+            continue;
+        stack.push_back({root, 0});
+        while (!stack.empty()) {
+            auto blk = stack.back().first;
+            auto outs = blk->outBlocks();
+            auto &next = stack.back().second;
+            if (next < outs.size()) {
+                auto sux = outs[next++];
+                if (visited.insert(sux).second)
+                    stack.push_back({sux, 0});
+            } else {
+                order.push_back(blk);
+                stack.pop_back();
+            }
+        }
+    }
+    return order;
+}
+void LiveAnalyzer::toSet(const Word *bits, int words, std::set<int> &set) {
+    set.clear();
+    for (int w = 0; w < words; ++w) {
+        for (Word b = bits[w]; b; b &= b - 1)
+            set.insert(set.end(), w * 64 + __builtin_ctzll(b));
+    }
 }
 
 
 }
-}
\ No newline at end of file
+}
@@ -6,17 +6,27 @@
 #define __MC_LIVE_ANALYZER_HH__
 
 #include "tgr.hh"
+#include <cstdint>
 
 namespace mc {
 namespace tgr {
 
+/*
+ * Backward liveness of virtual registers. Sets are dense bit vectors
+ * indexed by register id, blocks are visited in post-order from a
+ * worklist; live_in/live_out are filled in once the fixpoint is reached.
+ */
 class LiveAnalyzer {
 public:
     static void analyze(Module *mod);
 
 private:
-    static void localAnalyze(BasicBlock *blk);
+    using Word = uint64_t;
+
+    static void localAnalyze(BasicBlock *blk, Word *gen, Word *kill);
     static void globalAnalyze(Function *func);
+    static std::vector<BasicBlock *> postOrder(Function *func);
+    static void toSet(const Word *bits, int words, std::set<int> &set);
 };
 
 }
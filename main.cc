@@ -2,11 +2,16 @@
 #include "config.hh"
 #include "eyr_emitter.hh"
 #include "live_analyzer.hh"
+#include "peephole.hh"
+#include "ra_coloring.hh"
 #include "ra_greedy.hh"
+#include "ra_linear_scan.hh"
 #include "riscv_printer.hh"
+#include "slot_coloring.hh"
 #include "tgr_emitter.hh"
 #include "type_checker.hh"
 #include "eyr_optimizer.hh"
+#include <chrono>
 #include <cstdio>
 #include <fstream>
 #include <iostream>
@@ -34,8 +39,14 @@ int main(int argc, char **argv) {
             tgr_out("./output_tigger"),
             riscv_out("./output_riscv");
 
-    if (argc > 1)
-        yyin = fopen(argv[1], "r");
+    std::string reg_alloc = "greedy";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 4, "-ra=") == 0)
+            reg_alloc = arg.substr(4);
+        else
+            yyin = fopen(argv[i], "r");
+    }
     yyparse();
 
 #ifdef MC_DEBUG
@@ -54,6 +65,8 @@ int main(int argc, char **argv) {
     EyrEmitter emitter;
     auto mod = emitter.emit(*global_prog);
     eyr_out << *mod << std::endl;
+    delete global_prog;
+    ast_arena.release();
 
     EyrOptimizer e_opt;
     e_opt.optimize(mod);
@@ -62,9 +75,29 @@ int main(int argc, char **argv) {
     tgr::TgrEmitter te;
     auto tmod = te.emit(mod);
     ftgr_out << *tmod << std::endl;
+    delete mod;
+    auto live_start = chrono::steady_clock::now();
     tgr::LiveAnalyzer::analyze(tmod);
-    tgr::RAGreedy greedy;
-    greedy.allocate(tmod);
+    chrono::duration<double, milli> live_time = chrono::steady_clock::now() - live_start;
+    std::cerr << "liveness: " << live_time.count() << " ms" << std::endl;
+    if (reg_alloc == "linear") {
+        tgr::RALinearScan linear;
+        linear.allocate(tmod);
+    } else if (reg_alloc == "color") {
+        tgr::RAColoring coloring;
+        coloring.allocate(tmod);
+    } else {
+        tgr::RAGreedy greedy;
+        greedy.allocate(tmod);
+        greedy.report(std::cerr);
+    }
+    tgr::SlotColoring slot_coloring;
+    slot_coloring.optimize(tmod);
+    slot_coloring.report(std::cerr);
+    tgr::Peephole peephole;
+    peephole.optimize(tmod);
+    peephole.report(std::cerr);
+    tgr::printFrameAccesses(std::cerr, *tmod);
     tgr_out << *tmod << std::endl;
 
     tgr::RiscvPrinter rp(riscv_out);
@@ -72,4 +105,5 @@ int main(int argc, char **argv) {
 
     tgr::RiscvPrinter rp1(std::cout);
     rp1.printModule(tmod);
+    delete tmod;
 }
\ No newline at end of file
@@ -7,8 +7,8 @@
 
     static Type* tmp_base;
 
-    #define BIN(x, a, b) new BinaryExpr(BinaryExpr::BinOp::x, a, b)
-    #define UN(x, a) new UnaryExpr(UnaryExpr::UnOp::x, a)
+    #define BIN(x, a, b) ast_arena.make<BinaryExpr>(BinaryExpr::BinOp::x, a, b)
+    #define UN(x, a) ast_arena.make<UnaryExpr>(UnaryExpr::UnOp::x, a)
 
     extern int yylex();
     extern void yyerror(const char* s);
@@ -33,12 +33,12 @@
     CallExpr* call;
     RefExpr* ref;
     vector<Expr*>* exprs;
-    string* s;
+    Symbol sym;
     int i;
 }
 
 %token <i> NUM
-%token <s> ID
+%token <sym> ID
 %token IF ELSE WHILE RETURN EQ NE OR AND INT
 
 %type <asts> tops
@@ -84,15 +84,15 @@ top:
 // DeclStmt*
 var_decl:
     base_part ID array_part ';'
-        { $$ = new DeclStmt(*$2, $3); delete $2; }
+        { $$ = ast_arena.make<DeclStmt>($2, $3); }
     ;
 
 // Field*
 param:
     base_part ID array_part
-        { $$ = new Field(*$2, $3); delete $2; }
+        { $$ = ast_arena.make<Field>($2, $3); }
     | base_part ID '[' ']' array_part
-        { $$ = new Field(*$2, new VariantArrayType($5)); delete $2; }
+        { $$ = ast_arena.make<Field>($2, ast_arena.make<VariantArrayType>($5)); }
     ;
 
 // vector<Field*>*
@@ -114,7 +114,7 @@ param_list_:
 // Type*
 base_part:
     INT 
-        { $$ = tmp_base = new IntType; }
+        { $$ = tmp_base = ast_arena.make<IntType>(); }
     ;
 
 // Type*
@@ -122,19 +122,19 @@ array_part:
     %empty
         { $$ = tmp_base; }
     | '[' NUM ']' array_part
-        { $$ = new ArrayType($2, $4); }
+        { $$ = ast_arena.make<ArrayType>($2, $4); }
     ;
 
 // FuncDefn*
 func_defn:
     base_part ID '(' param_list_ ')' '{' comp_stmt '}'
-        { $$ = new FuncDefn($1, *$2, *$4, *$7); delete $2; delete $4; delete $7; }
+        { $$ = ast_arena.make<FuncDefn>($1, $2, *$4, *$7); delete $4; delete $7; }
     ;
 
 // DeclStmt*
 func_decl:
     base_part ID '(' param_list_ ')' ';'
-        { $$ = new DeclStmt(*$2, new FuncType($1, *$4)); delete $2; delete $4; }
+        { $$ = ast_arena.make<DeclStmt>($2, ast_arena.make<FuncType>($1, *$4)); delete $4; }
     ;
 
 // vector<Stmt*>*
@@ -148,7 +148,7 @@ comp_stmt:
 // Stmt*
 stmt:
     '{' comp_stmt '}'
-        { $$ = new BlockStmt(*$2); delete $2; }
+        { $$ = ast_arena.make<BlockStmt>(*$2); delete $2; }
     | if_stmt
         { $$ = $1; }
     | while_stmt
@@ -166,21 +166,21 @@ stmt:
 // IfStmt*
 if_stmt:
     IF '(' expr ')' stmt
-        { $$ = new IfStmt($3, $5); }
+        { $$ = ast_arena.make<IfStmt>($3, $5); }
     | IF '(' expr ')' stmt ELSE stmt
-        { $$ = new IfStmt($3, $5, $7); }
+        { $$ = ast_arena.make<IfStmt>($3, $5, $7); }
     ;
 
 // WhileStmt*
 while_stmt:
     WHILE '(' expr ')' stmt
-        { $$ = new WhileStmt($3, $5); }
+        { $$ = ast_arena.make<WhileStmt>($3, $5); }
     ;
 
 // ReturnStmt*
 ret_stmt:
     RETURN expr ';'
-        { $$ = new ReturnStmt($2); }
+        { $$ = ast_arena.make<ReturnStmt>($2); }
     ;
 
 // Expr*
@@ -268,7 +268,7 @@ rem_expr:
 // Expr*
 factor:
     NUM 
-        { $$ = new NumExpr($1); }
+        { $$ = ast_arena.make<NumExpr>($1); }
     | ref
         { $$ = $1; }
     | call
@@ -284,7 +284,7 @@ factor:
 // CallExpr*
 call:
     ID '(' arg_list_ ')'
-        { $$ = new CallExpr(*$1, *$3); delete $1; delete $3; }
+        { $$ = ast_arena.make<CallExpr>($1, *$3); delete $3; }
     ;
 
 // vector<Expr*>*
@@ -306,7 +306,7 @@ arg_list_:
 // RefExpr*
 ref:
     ID array_index
-        { $$ = new RefExpr(*$1, *$2); delete $1; delete $2; }
+        { $$ = ast_arena.make<RefExpr>($1, *$2); delete $2; }
     ;
 
 // vector<Expr*>*
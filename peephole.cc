@@ -0,0 +1,258 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#include "peephole.hh"
+#include <cassert>
+
+namespace mc {
+namespace tgr {
+
+static inline Operand PR(Reg pr) {
+    return Operand::PhyReg(pr);
+}
+static inline bool isReg(const Operand &opr, Reg r) {
+    return opr.tag == Operand::PHY_REG && opr.val.phy_reg == r;
+}
+static inline bool sameLoc(const Operand &a, const Operand &b) {
+    if (a.tag != b.tag)
+        return false;
+    if (a.tag == Operand::FRM_SLT)
+        return a.val.frm_slt == b.val.frm_slt;
+    return a.tag == Operand::GLB_VAR && a.val.glb_var == b.val.glb_var;
+}
+static std::set<Reg> usedRegs(Operation *op) {
+    std::set<Reg> res;
+    if (op->opt == Operation::CALL) {
+        for (int i = R2I(Reg::A0); i <= R2I(Reg::A7); ++i)
+            res.insert(I2R(i));
+    } else if (op->opt == Operation::TAIL) {
+        for (int i = R2I(Reg::A0); i <= R2I(Reg::A7); ++i)
+            res.insert(I2R(i));
+        res.insert(CalleeSavedRegs().begin(), CalleeSavedRegs().end());
+    } else if (op->opt == Operation::RET) {
+        res.insert(Reg::A0);
+        res.insert(CalleeSavedRegs().begin(), CalleeSavedRegs().end());
+    } else {
+        int d = op->getDefinedIndex();
+        for (int i = 0; i < 3; ++i) {
+            auto &opr = op->oprs[i];
+            if (i != d && opr.tag == Operand::PHY_REG && opr.val.phy_reg != Reg::X0)
+                res.insert(opr.val.phy_reg);
+        }
+    }
+    return res;
+}
+static std::set<Reg> definedRegs(Operation *op) {
+    if (op->opt == Operation::CALL)
+        return {CallerSavedRegs().begin(), CallerSavedRegs().end()};
+    int d = op->getDefinedIndex();
+    if (d >= 0 && op->oprs[d].tag == Operand::PHY_REG)
+        return {op->oprs[d].val.phy_reg};
+    return {};
+}
+static void replaceOp(Operation *op, Operation::Opt opt, std::array<Operand, 3> oprs) {
+    op->addBefore(op->block->function->module->makeOp(opt, oprs));
+    op->block->removeOp(op);
+}
+static void removeOp(Operation *op) {
+    op->block->removeOp(op);
+}
+
+const std::vector<Peephole::Pattern> &Peephole::patterns() {
+    static const std::vector<Pattern> table = {
+            {"self-move",      &Peephole::selfMove},
+            {"store-load",     &Peephole::storeLoad},
+            {"load-store",     &Peephole::loadStore},
+            {"load-load",      &Peephole::loadLoad},
+            {"def-move",       &Peephole::defMove},
+            {"compare-branch", &Peephole::compareBranch},
+            {"jump-next",      &Peephole::jumpNext},
+    };
+    return table;
+}
+
+void Peephole::optimize(Module *mod) {
+    fired.assign(patterns().size(), 0);
+    for (auto fun: mod->funcs)
+        runOnFunction(fun);
+}
+void Peephole::report(std::ostream &os) const {
+    for (size_t i = 0; i < fired.size(); ++i)
+        os << "peephole " << patterns()[i].name << ": " << fired[i] << std::endl;
+}
+void Peephole::runOnFunction(Function *fun) {
+    cur_fun = fun;
+    next_blk.clear();
+    for (size_t i = 0; i + 1 < fun->blocks.size(); ++i)
+        next_blk[fun->blocks[i]] = fun->blocks[i + 1];
+
+    auto &table = patterns();
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        computeLiveness();
+        for (auto blk: fun->blocks) {
+            auto op = blk->ops.empty() ? nullptr : blk->ops.front();
+            while (op) {
+                bool hit = false;
+                for (size_t i = 0; i < table.size() && !hit; ++i) {
+                    if ((this->*table[i].apply)(op))
+                        ++fired[i], hit = true;
+                }
+                changed = changed || hit;
+                // the operation may be gone, rescan the block
+                op = hit ? (blk->ops.empty() ? nullptr : blk->ops.front()) : op->next();
+            }
+        }
+    }
+}
+void Peephole::computeLiveness() {
+    live_in.clear();
+    std::map<BasicBlock *, std::set<Reg>> gen, kill;
+    for (auto blk: cur_fun->blocks) {
+        auto &g = gen[blk], &k = kill[blk];
+        for (auto op: blk->ops) {
+            for (auto r: usedRegs(op)) {
+                if (!k.count(r))
+                    g.insert(r);
+            }
+            for (auto r: definedRegs(op))
+                k.insert(r);
+        }
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (BasicBlock *blk: reverse(cur_fun->blocks)) {
+            auto in = gen[blk];
+            for (auto succ: blk->outBlocks()) {
+                for (auto r: live_in[succ]) {
+                    if (!kill[blk].count(r))
+                        in.insert(r);
+                }
+            }
+            if (in != live_in[blk])
+                live_in[blk].swap(in), changed = true;
+        }
+    }
+}
+bool Peephole::isLiveAfter(Operation *op, Reg r) {
+    for (auto cur = op->next(); cur; cur = cur->next()) {
+        if (usedRegs(cur).count(r))
+            return true;
+        if (definedRegs(cur).count(r))
+            return false;
+    }
+    for (auto succ: op->block->outBlocks()) {
+        if (live_in[succ].count(r))
+            return true;
+    }
+    return false;
+}
+
+// mv r, r
+bool Peephole::selfMove(Operation *op) {
+    if (op->opt != Operation::MOV || op->oprs[0].tag != Operand::PHY_REG)
+        return false;
+    if (!isReg(op->oprs[1], op->oprs[0].val.phy_reg))
+        return false;
+    removeOp(op);
+    return true;
+}
+// sw r, k(sp); lw r2, k(sp)  =>  sw r, k(sp); mv r2, r
+bool Peephole::storeLoad(Operation *op) {
+    auto next = op->next();
+    if (op->opt != Operation::STORE || !next || next->opt != Operation::LOAD)
+        return false;
+    if (!sameLoc(op->oprs[1], next->oprs[0]))
+        return false;
+    auto r = op->oprs[0].val.phy_reg, r2 = next->oprs[1].val.phy_reg;
+    if (r == r2)
+        removeOp(next);
+    else
+        replaceOp(next, Operation::MOV, {PR(r2), PR(r)});
+    return true;
+}
+// lw r, k(sp); sw r, k(sp)  =>  lw r, k(sp)
+bool Peephole::loadStore(Operation *op) {
+    auto next = op->next();
+    if (op->opt != Operation::LOAD || !next || next->opt != Operation::STORE)
+        return false;
+    if (!sameLoc(op->oprs[0], next->oprs[1]) || !isReg(next->oprs[0], op->oprs[1].val.phy_reg))
+        return false;
+    removeOp(next);
+    return true;
+}
+// lw r, k(sp); lw r2, k(sp)  =>  lw r, k(sp); mv r2, r
+bool Peephole::loadLoad(Operation *op) {
+    auto next = op->next();
+    if (op->opt != Operation::LOAD || !next || next->opt != Operation::LOAD)
+        return false;
+    if (!sameLoc(op->oprs[0], next->oprs[0]))
+        return false;
+    auto r = op->oprs[1].val.phy_reg, r2 = next->oprs[1].val.phy_reg;
+    if (r == r2)
+        removeOp(next);
+    else
+        replaceOp(next, Operation::MOV, {PR(r2), PR(r)});
+    return true;
+}
+// r = ...; mv r2, r  =>  r2 = ...  if r is dead afterwards
+bool Peephole::defMove(Operation *op) {
+    auto next = op->next();
+    int d = op->getDefinedIndex();
+    if (d < 0 || op->oprs[d].tag != Operand::PHY_REG || !next || next->opt != Operation::MOV)
+        return false;
+    auto r = op->oprs[d].val.phy_reg;
+    if (!isReg(next->oprs[1], r) || next->oprs[0].tag != Operand::PHY_REG || isLiveAfter(next, r))
+        return false;
+    op->oprs[d] = next->oprs[0];
+    removeOp(next);
+    return true;
+}
+// r = a < b; bne r, x0, l  =>  blt a, b, l  if r is dead afterwards
+bool Peephole::compareBranch(Operation *op) {
+    auto next = op->next();
+    if (!next || next->opt != Operation::BR_NE || !isReg(next->oprs[1], Reg::X0))
+        return false;
+    if (op->oprs[0].tag != Operand::PHY_REG || !isReg(next->oprs[0], op->oprs[0].val.phy_reg))
+        return false;
+    auto a = op->oprs[1], b = op->oprs[2];
+    Operation::Opt br;
+    switch (op->opt) {
+        when(Operation::BIN_EQ, br = Operation::BR_EQ;)
+        when(Operation::BIN_NE, br = Operation::BR_NE;)
+        when(Operation::BIN_LT, br = Operation::BR_LT;)
+        when(Operation::BIN_GT, br = Operation::BR_GT;)
+        when(Operation::UN_NOT, br = Operation::BR_EQ; b = PR(Reg::X0);)
+        default:
+            return false;
+    }
+    if (b.tag == Operand::INTEGER && b.val.integer == 0)
+        b = PR(Reg::X0);
+    if (a.tag != Operand::PHY_REG || b.tag != Operand::PHY_REG)
+        return false;
+    if (isLiveAfter(next, op->oprs[0].val.phy_reg))
+        return false;
+    replaceOp(next, br, {a, b, next->oprs[2]});
+    removeOp(op);
+    return true;
+}
+// j l  where l follows in the layout
+bool Peephole::jumpNext(Operation *op) {
+    auto blk = op->block;
+    if (op->opt != Operation::JUMP || op != blk->ops.back())
+        return false;
+    auto dst = op->oprs[0].val.bsc_blk;
+    if (next_blk[blk] != dst || blk->fall_out)
+        return false;
+    removeOp(op);
+    dst->jump_in.erase(blk);
+    blk->jump_out = nullptr;
+    blk->fall(dst);
+    return true;
+}
+
+}
+}
@@ -0,0 +1,54 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#ifndef __MC_PEEPHOLE_HH__
+#define __MC_PEEPHOLE_HH__
+
+#include "tgr.hh"
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace mc {
+namespace tgr {
+
+/*
+ * Peephole optimizer over allocated operations, run right before printing.
+ * Every pattern of the table is tried at every operation until none fires.
+ */
+class Peephole {
+public:
+    void optimize(Module *mod);
+    void report(std::ostream &os) const;
+
+private:
+    struct Pattern {
+        const char *name;
+        bool (Peephole::*apply)(Operation *op);
+    };
+    static const std::vector<Pattern> &patterns();
+
+    void runOnFunction(Function *fun);
+    void computeLiveness();
+    bool isLiveAfter(Operation *op, Reg r);
+
+    bool selfMove(Operation *op);
+    bool storeLoad(Operation *op);
+    bool loadStore(Operation *op);
+    bool loadLoad(Operation *op);
+    bool defMove(Operation *op);
+    bool compareBranch(Operation *op);
+    bool jumpNext(Operation *op);
+
+    Function *cur_fun{nullptr};
+    std::map<BasicBlock *, BasicBlock *> next_blk; // in layout order
+    std::map<BasicBlock *, std::set<Reg>> live_in;
+    std::vector<int> fired; // per pattern
+};
+
+}
+}
+
+#endif //__MC_PEEPHOLE_HH__
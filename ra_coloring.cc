@@ -0,0 +1,502 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#include "ra_coloring.hh"
+#include "ra_utils.hh"
+#include "tgr.hh"
+#include <algorithm>
+#include <cmath>
+
+namespace mc {
+namespace tgr {
+
+static inline Operand VR(int vr) {
+    return Operand::VirReg(vr);
+}
+static inline Operand FS(int f) {
+    return Operand::FrmSlt(f);
+}
+static inline bool isRegOpr(const Operand &opr) {
+    return opr.tag == Operand::VIR_REG || (opr.tag == Operand::PHY_REG && opr.val.phy_reg != Reg::X0);
+}
+static inline bool isMoveOp(Operation *op) {
+    auto &dst = op->oprs[0], &src = op->oprs[1];
+    return op->opt == Operation::MOV && isRegOpr(dst) && isRegOpr(src) &&
+           !(dst.tag == Operand::PHY_REG && src.tag == Operand::PHY_REG);
+}
+
+static constexpr int K = RegNum - 1;
+static constexpr int InfDegree = 1 << 29;
+
+void RAColoring::allocate(Module *mod) {
+    cur_mod = mod;
+
+    for (auto fun : mod->funcs) {
+        runOnFunction(fun);
+    }
+}
+void RAColoring::runOnFunction(Function *fun) {
+    cur_fun = fun;
+
+    taint_regs.clear(), no_spill_vrs.clear();
+    cur_exit = lowerPseudoOps(fun);
+    computeLoopDepth();
+    while (!tryColoring());
+    rewriteRegisters();
+    removeSelfMoves(fun);
+    saveCalleeSavedRegs(fun, cur_exit, taint_regs);
+    restoreBeforeTailCalls(fun, cur_exit);
+    cur_exit->addOp(Operation::RET, {});
+}
+void RAColoring::computeLoopDepth() {
+    auto &blocks = cur_fun->blocks;
+    int n = blocks.size();
+    std::map<BasicBlock *, int> index;
+    for (int i = 0; i < n; ++i)
+        index[blocks[i]] = i;
+
+    auto live = reachable(blocks, index, {0}, false);
+    auto dom = dominators(blocks, index, {0}, false);
+
+    // natural loops, merged by header
+    std::map<int, std::set<int>> loops;
+    for (int i = 0; i < n; ++i) {
+        if (!live[i])
+            continue;
+        for (auto succ : blocks[i]->outBlocks()) {
+            int h = index[succ];
+            if (!dom[i][h])
+                continue;
+            auto &body = loops[h];
+            body.insert(h);
+            std::vector<int> work;
+            if (body.insert(i).second)
+                work.push_back(i);
+            while (!work.empty()) {
+                auto b = work.back();
+                work.pop_back();
+                for (auto pred : blocks[b]->inBlocks()) {
+                    int p = index[pred];
+                    if (live[p] && body.insert(p).second)
+                        work.push_back(p);
+                }
+            }
+        }
+    }
+    loop_depth.clear();
+    for (auto blk : blocks)
+        loop_depth[blk] = 0;
+    for (auto &p : loops) {
+        for (auto b : p.second)
+            loop_depth[blocks[b]]++;
+    }
+}
+bool RAColoring::tryColoring() {
+    build();
+    makeWorklist();
+    while (true) {
+        if (!simplify_wl.empty())
+            simplify();
+        else if (!worklist_moves.empty())
+            coalesce();
+        else if (!freeze_wl.empty())
+            freeze();
+        else if (!spill_wl.empty())
+            selectSpill();
+        else
+            break;
+    }
+    assignColors();
+    if (spilled_nodes.empty())
+        return true;
+    rewriteProgram();
+    return false;
+}
+int RAColoring::nodeOf(int vr) {
+    auto it = vr2node.find(vr);
+    if (it == vr2node.end()) {
+        it = vr2node.insert({vr, (int) node2vr.size()}).first;
+        node2vr.push_back(vr);
+    }
+    return it->second;
+}
+void RAColoring::build() {
+    vr2node.clear(), node2vr.assign(RegNum, -1);
+    for (auto blk : cur_fun->blocks) {
+        for (auto op : blk->ops) {
+            for (auto &opr : op->oprs) {
+                if (opr.tag == Operand::VIR_REG)
+                    nodeOf(opr.val.vir_reg);
+            }
+        }
+    }
+    int n = node2vr.size();
+    adj_set.clear(), adj_list.assign(n, {}), degree.assign(n, 0);
+    spill_cost.assign(n, 0), alias.assign(n, -1), color.assign(n, Reg::X0);
+    simplify_wl.clear(), freeze_wl.clear(), spill_wl.clear();
+    spilled_nodes.clear(), coalesced_nodes.clear();
+    select_stack.clear(), on_stack.assign(n, false);
+    moves.clear(), move_list.assign(n, {});
+    worklist_moves.clear(), active_moves.clear();
+    for (int i = 1; i < RegNum; ++i)
+        degree[i] = InfDegree, color[i] = I2R(i);
+
+    for (auto blk : cur_fun->blocks) {
+        // the argument registers set before a call are read by it
+        std::map<Operation *, std::vector<int>> call_args;
+        std::vector<int> args;
+        for (auto op : blk->ops) {
+            int di = op->getDefinedIndex();
+            if (di >= 0 && op->oprs[di].tag == Operand::PHY_REG) {
+                auto r = op->oprs[di].val.phy_reg;
+                if (R2I(r) >= R2I(Reg::A0))
+                    args.push_back(R2I(r));
+            }
+            if (op->opt == Operation::CALL || op->opt == Operation::TAIL)
+                call_args[op].swap(args);
+        }
+
+        double weight = std::pow(10.0, std::min(loop_depth[blk], 6));
+        std::set<int> live;
+        for (auto vr : blk->live_out)
+            live.insert(nodeOf(vr));
+        for (Operation *op : reverse(blk->ops)) {
+            std::vector<int> uses, defs;
+            int di = op->getDefinedIndex();
+            for (int i = 0; i < 3; ++i) {
+                auto &opr = op->oprs[i];
+                if (!isRegOpr(opr))
+                    continue;
+                int nd = opr.tag == Operand::VIR_REG ? nodeOf(opr.val.vir_reg) : R2I(opr.val.phy_reg);
+                (i == di ? defs : uses).push_back(nd);
+                spill_cost[nd] += weight;
+            }
+            if (op->opt == Operation::CALL) {
+                for (auto r : CallerSavedRegs())
+                    defs.push_back(R2I(r));
+            }
+            if (op->opt == Operation::CALL || op->opt == Operation::TAIL) {
+                for (auto a : call_args[op])
+                    uses.push_back(a);
+            }
+            if (isMoveOp(op)) {
+                int m = moves.size();
+                moves.push_back(op);
+                for (auto u : uses)
+                    live.erase(u);
+                move_list[defs[0]].insert(m), move_list[uses[0]].insert(m);
+                worklist_moves.insert(m);
+            }
+            for (auto d : defs)
+                live.insert(d);
+            for (auto d : defs) {
+                for (auto l : live)
+                    addEdge(l, d);
+            }
+            for (auto d : defs)
+                live.erase(d);
+            for (auto u : uses)
+                live.insert(u);
+        }
+    }
+}
+void RAColoring::addEdge(int u, int v) {
+    if (u == v || adj_set.count({u, v}))
+        return;
+    adj_set.insert({u, v}), adj_set.insert({v, u});
+    if (!isPrecolored(u))
+        adj_list[u].push_back(v), degree[u]++;
+    if (!isPrecolored(v))
+        adj_list[v].push_back(u), degree[v]++;
+}
+void RAColoring::makeWorklist() {
+    for (int n = RegNum; n < (int) node2vr.size(); ++n) {
+        if (degree[n] >= K)
+            spill_wl.insert(n);
+        else if (moveRelated(n))
+            freeze_wl.insert(n);
+        else
+            simplify_wl.insert(n);
+    }
+}
+std::vector<int> RAColoring::adjacent(int n) {
+    std::vector<int> ret;
+    for (auto m : adj_list[n]) {
+        if (!on_stack[m] && !coalesced_nodes.count(m))
+            ret.push_back(m);
+    }
+    return ret;
+}
+std::set<int> RAColoring::nodeMoves(int n) {
+    std::set<int> ret;
+    for (auto m : move_list[n]) {
+        if (active_moves.count(m) || worklist_moves.count(m))
+            ret.insert(m);
+    }
+    return ret;
+}
+bool RAColoring::moveRelated(int n) {
+    return !nodeMoves(n).empty();
+}
+void RAColoring::simplify() {
+    auto n = *simplify_wl.begin();
+    simplify_wl.erase(simplify_wl.begin());
+    select_stack.push_back(n), on_stack[n] = true;
+    for (auto m : adjacent(n))
+        decrementDegree(m);
+}
+void RAColoring::decrementDegree(int m) {
+    if (isPrecolored(m))
+        return;
+    int d = degree[m]--;
+    if (d == K) {
+        enableMoves(m);
+        for (auto a : adjacent(m))
+            enableMoves(a);
+        spill_wl.erase(m);
+        if (moveRelated(m))
+            freeze_wl.insert(m);
+        else
+            simplify_wl.insert(m);
+    }
+}
+void RAColoring::enableMoves(int n) {
+    for (auto m : nodeMoves(n)) {
+        if (active_moves.erase(m))
+            worklist_moves.insert(m);
+    }
+}
+void RAColoring::coalesce() {
+    int m = *worklist_moves.begin();
+    worklist_moves.erase(worklist_moves.begin());
+    auto op = moves[m];
+    auto node = [&](const Operand &opr) {
+        return opr.tag == Operand::VIR_REG ? nodeOf(opr.val.vir_reg) : R2I(opr.val.phy_reg);
+    };
+    int x = getAlias(node(op->oprs[0])), y = getAlias(node(op->oprs[1]));
+    int u = x, v = y;
+    if (isPrecolored(y))
+        u = y, v = x;
+    if (u == v) {
+        addWorkList(u);
+    } else if (isPrecolored(v) || adj_set.count({u, v})) {
+        addWorkList(u), addWorkList(v);
+    } else {
+        bool can = false;
+        if (isPrecolored(u)) {
+            can = true;
+            for (auto t : adjacent(v))
+                can = can && ok(t, u);
+        } else {
+            auto nodes = adjacent(u), vs = adjacent(v);
+            nodes.insert(nodes.end(), vs.begin(), vs.end());
+            std::sort(nodes.begin(), nodes.end());
+            nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+            can = conservative(nodes);
+        }
+        if (can) {
+            combine(u, v);
+            addWorkList(u);
+        } else {
+            active_moves.insert(m);
+        }
+    }
+}
+void RAColoring::addWorkList(int u) {
+    if (!isPrecolored(u) && !moveRelated(u) && degree[u] < K) {
+        freeze_wl.erase(u);
+        simplify_wl.insert(u);
+    }
+}
+bool RAColoring::ok(int t, int r) {
+    return degree[t] < K || isPrecolored(t) || adj_set.count({t, r});
+}
+bool RAColoring::conservative(const std::vector<int> &nodes) {
+    int k = 0;
+    for (auto n : nodes) {
+        if (degree[n] >= K)
+            ++k;
+    }
+    return k < K;
+}
+int RAColoring::getAlias(int n) {
+    while (coalesced_nodes.count(n))
+        n = alias[n];
+    return n;
+}
+void RAColoring::combine(int u, int v) {
+    if (!freeze_wl.erase(v))
+        spill_wl.erase(v);
+    coalesced_nodes.insert(v);
+    alias[v] = u;
+    move_list[u].insert(move_list[v].begin(), move_list[v].end());
+    enableMoves(v);
+    for (auto t : adjacent(v)) {
+        addEdge(t, u);
+        decrementDegree(t);
+    }
+    if (degree[u] >= K && freeze_wl.erase(u))
+        spill_wl.insert(u);
+}
+void RAColoring::freeze() {
+    auto u = *freeze_wl.begin();
+    freeze_wl.erase(freeze_wl.begin());
+    simplify_wl.insert(u);
+    freezeMoves(u);
+}
+void RAColoring::freezeMoves(int u) {
+    for (auto m : nodeMoves(u)) {
+        auto op = moves[m];
+        auto node = [&](const Operand &opr) {
+            return opr.tag == Operand::VIR_REG ? nodeOf(opr.val.vir_reg) : R2I(opr.val.phy_reg);
+        };
+        int x = node(op->oprs[0]), y = node(op->oprs[1]);
+        int v = getAlias(y) == getAlias(u) ? getAlias(x) : getAlias(y);
+        active_moves.erase(m);
+        if (!isPrecolored(v) && nodeMoves(v).empty() && degree[v] < K) {
+            freeze_wl.erase(v);
+            simplify_wl.insert(v);
+        }
+    }
+}
+void RAColoring::selectSpill() {
+    // cheapest use count (weighted by loop depth) per interference, never the
+    // temporaries introduced by earlier spills: they live across a single op,
+    // spilling them again only makes new ones
+    int best = -1;
+    double best_cost = 0;
+    for (auto n : spill_wl) {
+        if (no_spill_vrs.count(node2vr[n]))
+            continue;
+        double cost = spill_cost[n] / degree[n];
+        if (best < 0 || cost < best_cost)
+            best = n, best_cost = cost;
+    }
+    // only temporaries left, push one optimistically, assignColors must color it
+    if (best < 0)
+        best = *spill_wl.begin();
+    spill_wl.erase(best);
+    simplify_wl.insert(best);
+    freezeMoves(best);
+}
+void RAColoring::assignColors() {
+    while (!select_stack.empty()) {
+        auto n = select_stack.back();
+        select_stack.pop_back(), on_stack[n] = false;
+        std::set<Reg> ok_colors(AllRegs().begin(), AllRegs().end());
+        for (auto w : adj_list[n]) {
+            auto a = getAlias(w);
+            if (color[a] != Reg::X0)
+                ok_colors.erase(color[a]);
+        }
+        if (ok_colors.empty()) {
+            assert(!no_spill_vrs.count(node2vr[n]));
+            spilled_nodes.insert(n);
+            continue;
+        }
+        // biased coloring: take the color of a node this one is copied from/to
+        Reg c = Reg::X0;
+        for (auto m : move_list[n]) {
+            for (int i = 0; i < 2 && c == Reg::X0; ++i) {
+                auto &opr = moves[m]->oprs[i];
+                auto a = getAlias(opr.tag == Operand::VIR_REG ? nodeOf(opr.val.vir_reg)
+                                                              : R2I(opr.val.phy_reg));
+                if (a != n && color[a] != Reg::X0 && ok_colors.count(color[a]))
+                    c = color[a];
+            }
+        }
+        color[n] = c != Reg::X0 ? c : choseColor(ok_colors);
+    }
+    for (auto n : coalesced_nodes)
+        color[n] = color[getAlias(n)];
+}
+Reg RAColoring::choseColor(const std::set<Reg> &ok_colors) {
+    // registers that need no saving first, then callee-saved ones that are saved anyway
+    for (auto r : CallerSavedRegs()) {
+        if (ok_colors.count(r))
+            return r;
+    }
+    for (auto r : CalleeSavedRegs()) {
+        if (ok_colors.count(r) && taint_regs.count(r))
+            return r;
+    }
+    auto r = *ok_colors.begin();
+    taint_regs.insert(r);
+    return r;
+}
+void RAColoring::rewriteProgram() {
+    std::map<int, int> slots;
+    for (auto n : spilled_nodes)
+        slots[node2vr[n]] = cur_fun->extendFrame(1);
+    for (auto blk : cur_fun->blocks) {
+        std::vector<Operation *> ops(blk->ops.begin(), blk->ops.end());
+        for (auto op : ops) {
+            int di = op->getDefinedIndex();
+            auto oprs = op->oprs;
+            std::map<int, int> temps;
+            std::vector<Operation *> loads, stores;
+            auto spilled = [&](int i) {
+                return oprs[i].tag == Operand::VIR_REG && slots.count(oprs[i].val.vir_reg);
+            };
+            auto tempOf = [&](int vr) {
+                auto it = temps.find(vr);
+                if (it == temps.end()) {
+                    it = temps.insert({vr, cur_mod->next_vir_reg_id++}).first;
+                    no_spill_vrs.insert(it->second);
+                }
+                return it->second;
+            };
+            // uses first, so that "t = t + x" loads t into the temporary it stores back
+            for (int i = 0; i < 3; ++i) {
+                if (i == di || !spilled(i))
+                    continue;
+                auto vr = oprs[i].val.vir_reg;
+                if (!temps.count(vr))
+                    loads.push_back(cur_mod->makeOp(Operation::LOAD, {FS(slots[vr]), VR(tempOf(vr))}));
+                oprs[i] = VR(temps[vr]);
+            }
+            if (di >= 0 && spilled(di)) {
+                auto vr = oprs[di].val.vir_reg;
+                stores.push_back(cur_mod->makeOp(Operation::STORE, {VR(tempOf(vr)), FS(slots[vr])}));
+                oprs[di] = VR(temps[vr]);
+            }
+            if (temps.empty())
+                continue;
+            auto new_op = cur_mod->makeOp(op->opt, oprs);
+            op->addBefore(new_op);
+            blk->removeOp(op);
+            for (auto ld : loads)
+                new_op->addBefore(ld);
+            for (Operation *st : reverse(stores))
+                new_op->addAfter(st);
+        }
+    }
+    for (auto blk : cur_fun->blocks) {
+        for (auto &p : slots) {
+            blk->live_in.erase(p.first);
+            blk->live_out.erase(p.first);
+        }
+    }
+}
+void RAColoring::rewriteRegisters() {
+    for (auto blk : cur_fun->blocks) {
+        for (auto op : blk->ops) {
+            std::set<int> vrs;
+            for (auto &opr : op->oprs) {
+                if (opr.tag == Operand::VIR_REG)
+                    vrs.insert(opr.val.vir_reg);
+            }
+            for (auto vr : vrs) {
+                auto c = color[nodeOf(vr)];
+                assert(c != Reg::X0);
+                if (isCalleeSaved(c))
+                    taint_regs.insert(c);
+                op->rewrite(vr, c);
+            }
+        }
+    }
+}
+
+}
+}
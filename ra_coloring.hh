@@ -0,0 +1,89 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#ifndef __MC_RA_COLORING_HH__
+#define __MC_RA_COLORING_HH__
+
+#include "tgr.hh"
+#include <set>
+#include <map>
+#include <vector>
+
+namespace mc {
+namespace tgr {
+
+/*
+ * Graph coloring with iterated register coalescing (George & Appel).
+ * Nodes 1..RegNum-1 are the precolored physical registers, every virtual
+ * register of the function gets a node after them. Spilled virtual registers
+ * are rewritten into short-lived temporaries and the function is colored again.
+ */
+class RAColoring {
+public:
+    void allocate(Module *mod);
+
+private:
+    Module *cur_mod;
+    Function *cur_fun;
+    BasicBlock *cur_exit;
+
+    std::map<BasicBlock *, int> loop_depth;
+    std::set<int> no_spill_vrs;
+    std::set<Reg> taint_regs;
+
+    // interference graph
+    std::map<int, int> vr2node;
+    std::vector<int> node2vr;
+    std::set<std::pair<int, int>> adj_set;
+    std::vector<std::vector<int>> adj_list;
+    std::vector<int> degree;
+    std::vector<double> spill_cost;
+    std::vector<int> alias;
+    std::vector<Reg> color;
+
+    // node work lists
+    std::set<int> simplify_wl, freeze_wl, spill_wl;
+    std::set<int> spilled_nodes, coalesced_nodes;
+    std::vector<int> select_stack;
+    std::vector<bool> on_stack;
+
+    // moves are numbered in program order to keep the allocation deterministic
+    std::vector<Operation *> moves;
+    std::vector<std::set<int>> move_list;
+    std::set<int> worklist_moves, active_moves;
+
+    void runOnFunction(Function *fun);
+    void computeLoopDepth();
+    bool tryColoring();
+    void build();
+    void makeWorklist();
+    void simplify();
+    void coalesce();
+    void freeze();
+    void selectSpill();
+    void assignColors();
+    void rewriteProgram();
+    void rewriteRegisters();
+
+    int nodeOf(int vr);
+    bool isPrecolored(int n) const { return n < RegNum; }
+    void addEdge(int u, int v);
+    std::vector<int> adjacent(int n);
+    std::set<int> nodeMoves(int n);
+    bool moveRelated(int n);
+    void decrementDegree(int m);
+    void enableMoves(int n);
+    void addWorkList(int u);
+    bool ok(int t, int r);
+    bool conservative(const std::vector<int> &nodes);
+    int getAlias(int n);
+    void combine(int u, int v);
+    void freezeMoves(int u);
+    Reg choseColor(const std::set<Reg> &ok_colors);
+};
+
+}
+}
+
+#endif //__MC_RA_COLORING_HH__
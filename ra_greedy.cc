@@ -3,6 +3,7 @@
 //
 
 #include "ra_greedy.hh"
+#include "ra_utils.hh"
 #include "tgr.hh"
 #include <algorithm>
 #include <functional>
@@ -31,6 +32,7 @@ static inline Operand FS(int f) {
 
 void RAGreedy::allocate(Module *mod) {
     cur_mod = mod;
+    stats.clear();
 
     for (auto fun : mod->funcs) {
         runOnFunction(fun);
@@ -39,8 +41,9 @@ void RAGreedy::allocate(Module *mod) {
 void RAGreedy::runOnFunction(Function *fun) {
     cur_fun = fun;
 
-    cur_exit = new BasicBlock(cur_mod->next_label++);
+    cur_exit = cur_mod->make<BasicBlock>(cur_mod->next_label++);
     taint_regs.clear(), vr2slt.clear();
+    stats.push_back({fun->name, 0, 0});
     for (auto blk : fun->blocks) {
         runOnBlock(blk);
     }
@@ -49,7 +52,8 @@ void RAGreedy::runOnFunction(Function *fun) {
     assert(!end_blk->fall_out);
     if (!end_blk->jump_out)
         end_blk->fall(cur_exit);
-    saveCalleeSavedRegs();
+    saveCalleeSavedRegs(cur_fun, cur_exit, taint_regs);
+    restoreBeforeTailCalls(cur_fun, cur_exit);
     cur_exit->addOp(Operation::RET, {});
 }
 void RAGreedy::runOnBlock(BasicBlock *blk) {
@@ -110,10 +114,11 @@ void RAGreedy::spill(int r, Reg p) {
         auto slt = getFrmSlt(r);
         genBefore(Operation::STORE, {PR(p), FS(slt)});
         enterFrame(r);
+        stats.back().spills++;
     }
 }
 void RAGreedy::genAfter(Operation::Opt opt, std::array<Operand, 3> oprs) {
-    auto new_op = new Operation(opt, oprs);
+    auto new_op = cur_mod->makeOp(opt, oprs);
     cur_op->addAfter(new_op);
 }
 std::set<int> &RAGreedy::refVirRegs(Reg pr) {
@@ -139,17 +144,23 @@ bool RAGreedy::isInFrame(int vr) {
 }
 void RAGreedy::liveAnalyze() {
     live_vrs.clear();
-    auto cur_live = cur_blk->live_out;
+    // live-out values not read again are taken as read right after the block
+    int pos = cur_blk->ops.size();
+    std::map<int, int> cur_live;
+    for (auto vr : cur_blk->live_out)
+        cur_live[vr] = pos;
+    live_vrs[nullptr] = cur_live;
     for (Operation *op : reverse(cur_blk->ops)) {
+        --pos;
         for (auto def : op->getDefinedVirRegs())
             cur_live.erase(def);
         for (auto use : op->getUsedVirRegs())
-            cur_live.insert(use);
+            cur_live[use] = pos;
         live_vrs[op] = cur_live;
     }
 }
 void RAGreedy::genBefore(Operation::Opt opt, std::array<Operand, 3> oprs) {
-    auto new_op = new Operation(opt, oprs);
+    auto new_op = cur_mod->makeOp(opt, oprs);
     cur_op->addBefore(new_op);
 }
 bool RAGreedy::isAlive(int r) {
@@ -172,10 +183,11 @@ void RAGreedy::allocPhyRegsFor(Operation *op) {
     for (auto vr : uses) {
         if (!isInPhyReg(vr)) {
             assert(isInFrame(vr));
-            auto pr = findPhyRegBeyond(uses);
+            auto pr = findPhyRegBeyond(uses, vr);
             auto slt = getFrmSlt(vr);
             unbind(pr);
             genBefore(Operation::LOAD, {FS(slt), PR(pr)});
+            stats.back().reloads++;
             taint_regs.insert(pr);
             bind(vr, pr);
             op->rewrite(vr, pr);
@@ -185,17 +197,37 @@ void RAGreedy::allocPhyRegsFor(Operation *op) {
         }
     }
     for (auto vr : defs) {
-        auto pr = isInPhyReg(vr) ? getPhyReg(vr) : findPhyRegBeyond(defs);
+        auto pr = isInPhyReg(vr) ? getPhyReg(vr) : findPhyRegBeyond(defs, vr);
         unbind(vr);
+        // values read for the last time by this operation need no saving
+        auto occupants = refVirRegs(pr);
+        for (auto r : occupants) {
+            if (!isLiveAfter(r))
+                unbind(r);
+        }
         unbind(pr);
         bind(vr, pr);
         op->rewrite(vr, pr);
         taint_regs.insert(pr);
     }
 }
-Reg RAGreedy::findPhyRegBeyond(const std::set<int> &vrs) {
+Reg RAGreedy::findPhyRegBeyond(const VirRegSet &vrs, int vr) {
+    // A value living across a call would be spilled and reloaded around it in
+    // a caller-saved register, a callee-saved one costs a save and restore per
+    // function, nothing if the function already uses it. Short values take the
+    // caller-saved registers first and keep the callee-saved ones untouched.
+    std::vector<Reg> order, fresh;
+    bool crossing = crossesCall(vr);
+    if (!crossing)
+        order = CallerSavedRegs();
+    for (auto pr : CalleeSavedRegs())
+        (taint_regs.count(pr) ? order : fresh).push_back(pr);
+    order.insert(order.end(), fresh.begin(), fresh.end());
+    if (crossing)
+        order.insert(order.end(), CallerSavedRegs().begin(), CallerSavedRegs().end());
+
     std::vector<Reg> left;
-    for (auto pr : AllRegs()) {
+    for (auto pr : order) {
         if (!isOccupied(pr))
             return pr;
         bool ok = true;
@@ -211,12 +243,52 @@ Reg RAGreedy::findPhyRegBeyond(const std::set<int> &vrs) {
     return choseEvictor(left);
 }
 Reg RAGreedy::choseEvictor(const std::vector<Reg> &regs) {
-    static std::default_random_engine rng;
-
-    (void) vr2pr;
+    // Belady: evict the register whose values are needed again the latest,
+    // dead values never. Among equally distant ones, prefer those needing
+    // no store: already in the frame or held by another register too.
     assert(!regs.empty());
-    std::uniform_int_distribution<int> dist(0, regs.size() - 1);
-    return regs[dist(rng)];
+    Reg victim = regs.front();
+    int victim_dist = -1, victim_cost = MaxInt();
+    for (auto pr : regs) {
+        int dist = MaxInt(), cost = 0;
+        for (auto vr : refVirRegs(pr)) {
+            int next = nextUse(vr);
+            if (next == MaxInt())
+                continue;
+            dist = std::min(dist, next);
+            if (!isInFrame(vr) && refPhyRegs(vr).size() == 1)
+                ++cost;
+        }
+        if (dist > victim_dist || (dist == victim_dist && cost < victim_cost)) {
+            victim = pr;
+            victim_dist = dist;
+            victim_cost = cost;
+        }
+    }
+    return victim;
+}
+// position of the next read after the current op, MaxInt if the value is dead
+int RAGreedy::nextUse(int vr) {
+    auto &live = live_vrs[cur_op->next()];
+    auto it = live.find(vr);
+    return it == live.end() ? MaxInt() : it->second;
+}
+// whether the value is alive at a later call in this block
+bool RAGreedy::crossesCall(int vr) {
+    for (auto op = cur_op->next(); op; op = op->next()) {
+        if (op->getDefinedVirRegs().count(vr))
+            return false;
+        if (op->opt == Operation::CALL)
+            return live_vrs[op].count(vr) > 0;
+    }
+    return false;
+}
+bool RAGreedy::isLiveAfter(int r) {
+    return live_vrs[cur_op->next()].count(r) > 0;
+}
+void RAGreedy::report(std::ostream &os) const {
+    for (auto &st : stats)
+        os << "f_" << st.fun << ": " << st.spills << " spills, " << st.reloads << " reloads" << std::endl;
 }
 Reg RAGreedy::getPhyReg(int vr) {
     return *refPhyRegs(vr).begin();
@@ -225,7 +297,6 @@ void RAGreedy::removeAndStepIn() {
     auto op = cur_op;
     cur_op = op->next();
     cur_blk->removeOp(op);
-    delete (op);
 }
 void RAGreedy::handleMov(Operation *op) {
     auto dst = op->oprs[0];
@@ -237,10 +308,11 @@ void RAGreedy::handleMov(Operation *op) {
         auto r1 = dst.val.vir_reg, r2 = src.val.vir_reg;
         if (!isInPhyReg(r2)) {
             assert(isInFrame(r2));
-            auto p2 = findPhyRegBeyond({r2});
+            auto p2 = findPhyRegBeyond({r2}, r2);
             auto slt = getFrmSlt(r2);
             unbind(p2);
             genBefore(Operation::LOAD, {FS(slt), PR(p2)});
+            stats.back().reloads++;
             taint_regs.insert(p2);
             bind(r2, p2);
 
@@ -314,6 +386,7 @@ void RAGreedy::moveOpr2PhyReg(const Operand &src, Reg ai) {
             auto fs = getFrmSlt(vr);
             unbind(ai);
             genBefore(Operation::LOAD, {FS(fs), PR(ai)});
+            stats.back().reloads++;
         }
     } else if (src.tag == Operand::GLB_VAR) {
         unbind(ai);
@@ -335,17 +408,16 @@ void RAGreedy::moveOpr2PhyReg(const Operand &src, Reg ai) {
     }
 }
 void RAGreedy::saveRegsInBlockEnd() {
-    if (cur_blk->ops.empty())
-        return;
-    auto last_op = cur_blk->ops.back();
-    auto opt = last_op->opt;
-    if (opt == Operation::JUMP && cur_blk->jump_out == cur_exit)
+    // a block may have been emptied, e.g. one holding only __get_param
+    auto last_op = cur_blk->ops.empty() ? nullptr : cur_blk->ops.back();
+    bool is_jump = last_op && last_op->opt == Operation::JUMP;
+    if (is_jump && cur_blk->jump_out == cur_exit)
         return;
     std::function<void(Operation::Opt opt, std::array<Operand, 3> oprs)>
             gen_lmd;
-    if (opt == Operation::JUMP || opt == Operation::BR_NE) {
+    if (is_jump || (last_op && last_op->isBrOp())) {
         gen_lmd = [&](Operation::Opt opt, std::array<Operand, 3> oprs) -> void {
-            last_op->addBefore(new Operation(opt, oprs));
+            last_op->addBefore(cur_mod->makeOp(opt, oprs));
         };
     } else {
         gen_lmd = [&](Operation::Opt opt, std::array<Operand, 3> oprs) -> void {
@@ -356,28 +428,7 @@ void RAGreedy::saveRegsInBlockEnd() {
         if (!isInFrame(vr)) {
             assert(isInPhyReg(vr));
             gen_lmd(Operation::STORE, {PR(getPhyReg(vr)), FS(getFrmSlt(vr))});
-        }
-    }
-}
-void RAGreedy::saveCalleeSavedRegs() {
-    auto entry = cur_fun->blocks[0];
-    auto exit = cur_exit;
-    std::function<void(Operation::Opt opt, std::array<Operand, 3> oprs)>
-            gen_lmd;
-    if (entry->ops.empty()) {
-        gen_lmd = [&](Operation::Opt opt, std::array<Operand, 3> oprs) -> void {
-            entry->addOp(opt, oprs);
-        };
-    } else {
-        gen_lmd = [&](Operation::Opt opt, std::array<Operand, 3> oprs) -> void {
-            entry->ops.front()->addBefore(new Operation(opt, oprs));
-        };
-    }
-    for (auto pr : taint_regs) {
-        if (isCalleeSaved(pr)) {
-            auto slt = cur_fun->extendFrame(1);
-            gen_lmd(Operation::STORE, {PR(pr), FS(slt)});
-            exit->addOp(Operation::LOAD, {FS(slt), PR(pr)});
+            stats.back().spills++;
         }
     }
 }
@@ -16,8 +16,14 @@ namespace tgr {
 class RAGreedy {
 public:
     void allocate(Module *mod);
+    void report(std::ostream &os) const; // spills and reloads per function
 
 private:
+    struct SpillStats {
+        std::string fun;
+        int spills, reloads;
+    };
+    std::vector<SpillStats> stats;
 
     std::map<int, int> vr2slt;
     std::set<Reg> taint_regs;
@@ -31,7 +37,9 @@ private:
     BasicBlock *cur_blk;
     Operation *cur_op;
 
-    std::map<Operation *, std::set<int>> live_vrs;
+    // values alive before each op of the block, and at its end under nullptr,
+    // each with the position of its next read in the block
+    std::map<Operation *, std::map<int, int>> live_vrs;
 
     std::set<Reg> arg_prs;
 
@@ -55,6 +63,7 @@ private:
     void enterFrame(int vr);
     void leaveFrame(int vr);
     bool isAlive(int r);
+    bool isLiveAfter(int r);
     bool isInFrame(int vr);
     bool isInPhyReg(int vr);
 
@@ -68,11 +77,12 @@ private:
     void removeAndStepIn();
     void moveOpr2PhyReg(const Operand &opr, Reg pr);
     void saveRegsInBlockEnd();
-    void saveCalleeSavedRegs();
     void allocPhyRegsFor(Operation *op);
-    Reg findPhyRegBeyond(const std::set<int> &vrs);
+    Reg findPhyRegBeyond(const VirRegSet &vrs, int vr);
+    bool crossesCall(int vr);
 
     Reg choseEvictor(const std::vector<Reg> &regs);
+    int nextUse(int vr);
 
     void liveAnalyze();
 };
@@ -0,0 +1,606 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#include "ra_linear_scan.hh"
+#include "ra_utils.hh"
+#include "tgr.hh"
+#include <algorithm>
+
+namespace mc {
+namespace tgr {
+
+static inline Operand PR(Reg pr) {
+    return Operand::PhyReg(pr);
+}
+static inline Operand BB(BasicBlock *blk) {
+    return Operand::BscBlk(blk);
+}
+static inline Operand FS(int f) {
+    return Operand::FrmSlt(f);
+}
+static inline int gapOf(int pos) {
+    return pos & ~3;
+}
+static inline bool sameLocation(const Operand &a, const Operand &b) {
+    if (a.tag != b.tag)
+        return false;
+    return a.tag == Operand::PHY_REG ? a.val.phy_reg == b.val.phy_reg
+                                     : a.val.frm_slt == b.val.frm_slt;
+}
+
+bool RALinearScan::Interval::covers(int pos) const {
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), pos,
+                               [](int p, const Range &r) { return p < r.from; });
+    return it != ranges.begin() && pos < (--it)->to;
+}
+int RALinearScan::Interval::nextUseFrom(int pos) const {
+    auto it = std::lower_bound(uses.begin(), uses.end(), pos);
+    return it == uses.end() ? MaxInt() : *it;
+}
+
+void RALinearScan::allocate(Module *mod) {
+    cur_mod = mod;
+
+    for (auto fun : mod->funcs) {
+        runOnFunction(fun);
+    }
+}
+void RALinearScan::runOnFunction(Function *fun) {
+    cur_fun = fun;
+
+    vr2itv.clear(), blk_pos.clear(), gap2op.clear(), vr2slt.clear();
+    taint_regs.clear(), unhandled.clear(), active.clear(), inactive.clear();
+    fixed_itvs.fill(nullptr);
+    tmp_slt = -1;
+
+    cur_exit = lowerPseudoOps(fun);
+    numberOperations();
+    buildIntervals();
+    buildFixedIntervals();
+    linearScan();
+    assignRegisters();
+    resolveSplits();
+    resolveEdges();
+    removeSelfMoves(fun);
+    saveCalleeSavedRegs(fun, cur_exit, taint_regs);
+    restoreBeforeTailCalls(fun, cur_exit);
+    cur_exit->addOp(Operation::RET, {});
+
+    for (auto it : all_itvs)
+        delete (it);
+    all_itvs.clear();
+}
+void RALinearScan::numberOperations() {
+    int pos = 0;
+    for (auto blk : cur_fun->blocks) {
+        int from = pos;
+        gap2op.push_back(nullptr), pos += 4;
+        for (auto op : blk->ops)
+            gap2op.push_back(op), pos += 4;
+        blk_pos[blk] = {from, pos};
+    }
+}
+void RALinearScan::buildIntervals() {
+    for (BasicBlock *blk : reverse(cur_fun->blocks)) {
+        int from = blk_pos[blk].first, to = blk_pos[blk].second;
+        auto live = blk->live_out;
+        for (auto vr : live)
+            addRange(getInterval(vr), from, to);
+        int pos = to - 4;
+        for (Operation *op : reverse(blk->ops)) {
+            for (auto vr : op->getDefinedVirRegs()) {
+                auto it = getInterval(vr);
+                if (live.erase(vr))
+                    it->ranges.back().from = pos + 2;
+                else
+                    addRange(it, pos + 2, pos + 3);
+                it->uses.push_back(pos + 2);
+            }
+            for (auto vr : op->getUsedVirRegs()) {
+                auto it = getInterval(vr);
+                addRange(it, from, pos + 2);
+                it->uses.push_back(pos + 1);
+                live.insert(vr);
+            }
+            if (op->opt == Operation::MOV) {
+                auto &dst = op->oprs[0], &src = op->oprs[1];
+                if (dst.tag == Operand::VIR_REG && src.tag == Operand::PHY_REG) {
+                    getInterval(dst.val.vir_reg)->hint_pr = src.val.phy_reg;
+                } else if (dst.tag == Operand::PHY_REG && src.tag == Operand::VIR_REG) {
+                    auto it = getInterval(src.val.vir_reg);
+                    if (it->hint_pr == Reg::X0)
+                        it->hint_pr = dst.val.phy_reg;
+                } else if (dst.tag == Operand::VIR_REG && src.tag == Operand::VIR_REG) {
+                    getInterval(dst.val.vir_reg)->hint_vr = src.val.vir_reg;
+                }
+            }
+            pos -= 4;
+        }
+    }
+    for (auto &p : vr2itv) {
+        auto it = p.second;
+        std::reverse(it->ranges.begin(), it->ranges.end());
+        std::reverse(it->uses.begin(), it->uses.end());
+        it->uses.erase(std::unique(it->uses.begin(), it->uses.end()), it->uses.end());
+    }
+}
+void RALinearScan::buildFixedIntervals() {
+    std::vector<std::vector<Range>> ranges(RegNum);
+    for (auto blk : cur_fun->blocks) {
+        int pos = blk_pos[blk].first;
+        std::map<Reg, Range> open;
+        auto close = [&](Reg r, int to) {
+            auto it = open.find(r);
+            if (it != open.end()) {
+                it->second.to = std::max(it->second.to, to);
+                ranges[R2I(r)].push_back(it->second);
+                open.erase(it);
+            }
+        };
+        if (blk == cur_fun->blocks.front()) {
+            for (int i = 0; i < cur_fun->argc; ++i)
+                open[I2R(R2I(Reg::A0) + i)] = {pos, pos + 1};
+        }
+        for (auto op : blk->ops) {
+            pos += 4;
+            int di = op->getDefinedIndex();
+            for (int i = 0; i < 3; ++i) {
+                auto &opr = op->oprs[i];
+                if (i != di && opr.tag == Operand::PHY_REG && opr.val.phy_reg != Reg::X0) {
+                    assert(open.count(opr.val.phy_reg));
+                    close(opr.val.phy_reg, pos + 2);
+                }
+            }
+            if (op->opt == Operation::CALL) {
+                // arguments are read by the call, every caller-saved register is clobbered
+                while (!open.empty())
+                    close(open.begin()->first, pos + 2);
+                for (auto r : CallerSavedRegs())
+                    ranges[R2I(r)].push_back({pos + 2, pos + 3});
+                open[Reg::A0] = {pos + 2, pos + 3};
+            }
+            if (di >= 0 && op->oprs[di].tag == Operand::PHY_REG) {
+                auto r = op->oprs[di].val.phy_reg;
+                close(r, 0);
+                open[r] = {pos + 2, pos + 3};
+            }
+        }
+        while (!open.empty())
+            close(open.begin()->first, blk_pos[blk].second);
+    }
+    for (auto r : AllRegs()) {
+        auto it = newInterval(-1);
+        it->fixed = true, it->reg = r, it->top = it;
+        fixed_itvs[R2I(r)] = it;
+        auto &rs = ranges[R2I(r)];
+        std::sort(rs.begin(), rs.end(), [](const Range &a, const Range &b) {
+            return a.from < b.from;
+        });
+        for (auto &rg : rs) {
+            if (!it->ranges.empty() && it->ranges.back().to >= rg.from)
+                it->ranges.back().to = std::max(it->ranges.back().to, rg.to);
+            else
+                it->ranges.push_back(rg);
+        }
+    }
+}
+void RALinearScan::linearScan() {
+    for (auto r : AllRegs()) {
+        auto it = fixed_itvs[R2I(r)];
+        if (!it->ranges.empty())
+            inactive.push_back(it);
+    }
+    for (auto &p : vr2itv) {
+        if (!p.second->ranges.empty())
+            unhandled.insert(p.second);
+    }
+    while (!unhandled.empty()) {
+        auto cur = *unhandled.begin();
+        unhandled.erase(unhandled.begin());
+        int pos = cur->start();
+
+        std::vector<Interval *> new_active, new_inactive;
+        for (auto it : active) {
+            if (it->end() > pos)
+                (it->covers(pos) ? new_active : new_inactive).push_back(it);
+        }
+        for (auto it : inactive) {
+            if (it->end() > pos)
+                (it->covers(pos) ? new_active : new_inactive).push_back(it);
+        }
+        active.swap(new_active), inactive.swap(new_inactive);
+
+        if (!tryAllocateFreeReg(cur))
+            allocateBlockedReg(cur);
+        if (cur->reg != Reg::X0)
+            active.push_back(cur);
+    }
+}
+bool RALinearScan::tryAllocateFreeReg(Interval *cur) {
+    std::array<int, RegNum> free_until;
+    free_until.fill(MaxInt());
+    for (auto it : active)
+        free_until[R2I(it->reg)] = 0;
+    for (auto it : inactive) {
+        int x = intersection(it, cur);
+        if (x != MaxInt())
+            free_until[R2I(it->reg)] = std::min(free_until[R2I(it->reg)], gapOf(x));
+    }
+
+    int start = cur->start(), end = cur->end();
+    auto hint = hintOf(cur);
+    auto fits = [&](Reg r) { return free_until[R2I(r)] >= end; };
+    Reg reg = Reg::X0;
+    // prefer the hint, then registers that need no saving, then callee-saved ones
+    // that are saved anyway
+    if (hint != Reg::X0 && fits(hint))
+        reg = hint;
+    for (auto r : CallerSavedRegs()) {
+        if (reg == Reg::X0 && fits(r))
+            reg = r;
+    }
+    for (auto r : CalleeSavedRegs()) {
+        if (reg == Reg::X0 && fits(r) && taint_regs.count(r))
+            reg = r;
+    }
+    for (auto r : CalleeSavedRegs()) {
+        if (reg == Reg::X0 && fits(r))
+            reg = r;
+    }
+    if (reg != Reg::X0) {
+        cur->reg = reg;
+        taint_regs.insert(reg);
+        return true;
+    }
+
+    // no register is free for the whole interval: take the one that stays free
+    // the longest and split the interval before it gets occupied
+    reg = AllRegs().front();
+    for (auto r : AllRegs()) {
+        if (free_until[R2I(r)] > free_until[R2I(reg)])
+            reg = r;
+    }
+    if (free_until[R2I(reg)] <= start)
+        return false;
+    cur->reg = reg;
+    taint_regs.insert(reg);
+    unhandled.insert(split(cur, free_until[R2I(reg)]));
+    return true;
+}
+void RALinearScan::allocateBlockedReg(Interval *cur) {
+    int start = cur->start(), gap = gapOf(start);
+    std::array<int, RegNum> next_use, block_pos;
+    next_use.fill(MaxInt()), block_pos.fill(MaxInt());
+    for (auto it : active) {
+        auto r = R2I(it->reg);
+        if (it->fixed)
+            next_use[r] = block_pos[r] = 0;
+        else
+            next_use[r] = std::min(next_use[r], it->nextUseFrom(gap));
+    }
+    for (auto it : inactive) {
+        int x = intersection(it, cur);
+        if (x == MaxInt())
+            continue;
+        auto r = R2I(it->reg);
+        if (it->fixed) {
+            block_pos[r] = std::min(block_pos[r], gapOf(x));
+            next_use[r] = std::min(next_use[r], block_pos[r]);
+        } else {
+            next_use[r] = std::min(next_use[r], it->nextUseFrom(gap));
+        }
+    }
+    for (auto r : AllRegs()) {
+        if (block_pos[R2I(r)] <= start)
+            next_use[R2I(r)] = 0;
+    }
+
+    Reg reg = AllRegs().front();
+    for (auto r : AllRegs()) {
+        if (next_use[R2I(r)] > next_use[R2I(reg)])
+            reg = r;
+    }
+    int first_use = cur->nextUseFrom(start);
+    if (first_use == MaxInt() || first_use > next_use[R2I(reg)]) {
+        // all registers are needed earlier than the current interval: spill it
+        // until its first use
+        cur->spilled = true;
+        if (first_use != MaxInt()) {
+            assert(gapOf(first_use) > start);
+            unhandled.insert(split(cur, gapOf(first_use)));
+        }
+        return;
+    }
+
+    cur->reg = reg;
+    taint_regs.insert(reg);
+    if (block_pos[R2I(reg)] < cur->end())
+        unhandled.insert(split(cur, block_pos[R2I(reg)]));
+    // evict whoever else occupies the register
+    auto act = active;
+    for (auto it : act) {
+        if (!it->fixed && it->reg == reg)
+            splitAndSpill(it, gap);
+    }
+    auto inact = inactive;
+    for (auto it : inact) {
+        if (!it->fixed && it->reg == reg && intersection(it, cur) != MaxInt()) {
+            auto child = split(it, start);
+            assert(child);
+            unhandled.insert(child);
+        }
+    }
+}
+void RALinearScan::splitAndSpill(Interval *it, int pos) {
+    auto spilled = it;
+    if (pos > it->start()) {
+        spilled = split(it, pos);
+    } else {
+        active.erase(std::remove(active.begin(), active.end(), it), active.end());
+        inactive.erase(std::remove(inactive.begin(), inactive.end(), it), inactive.end());
+    }
+    spilled->reg = Reg::X0;
+    spilled->spilled = true;
+    int use = spilled->nextUseFrom(spilled->start());
+    if (use != MaxInt()) {
+        assert(gapOf(use) > spilled->start());
+        unhandled.insert(split(spilled, gapOf(use)));
+    }
+}
+void RALinearScan::assignRegisters() {
+    for (auto blk : cur_fun->blocks) {
+        int pos = blk_pos[blk].first;
+        for (auto op : blk->ops) {
+            pos += 4;
+            int di = op->getDefinedIndex();
+            for (int i = 0; i < 3; ++i) {
+                auto &opr = op->oprs[i];
+                if (opr.tag != Operand::VIR_REG)
+                    continue;
+                auto it = pieceAt(opr.val.vir_reg, i == di ? pos + 2 : pos + 1);
+                assert(it && it->reg != Reg::X0);
+                opr = PR(it->reg);
+            }
+        }
+    }
+}
+void RALinearScan::resolveSplits() {
+    std::map<int, std::vector<std::pair<Operand, Operand>>> moves;
+    for (auto it : all_itvs) {
+        if (it->fixed || it->top == it || it->ranges.empty())
+            continue;
+        int pos = it->start();
+        // splits at block boundaries are resolved on the edges
+        if (pos % 4 != 0 || gap2op[pos / 4] == nullptr)
+            continue;
+        // nothing to move if the split is inside a lifetime hole
+        if (!pieceAt(it->vr, pos - 1))
+            continue;
+        auto from = locationAt(it->vr, pos - 1), to = locationAt(it->vr, pos);
+        if (!sameLocation(from, to))
+            moves[pos].push_back({from, to});
+    }
+    for (auto &p : moves) {
+        std::vector<Operation *> ops;
+        emitMoves(p.second, ops);
+        for (auto op : ops)
+            gap2op[p.first / 4]->addBefore(op);
+    }
+}
+void RALinearScan::resolveEdges() {
+    std::vector<BasicBlock *> layout, tail;
+    auto blocks = cur_fun->blocks;
+    for (auto blk : blocks) {
+        layout.push_back(blk);
+        if (blk == cur_exit)
+            continue;
+        auto outs = blk->outBlocks();
+        for (size_t k = 0; k < outs.size(); ++k) {
+            auto succ = outs[k];
+            bool is_fall = k == 0 && blk->fall_out;
+            if (succ == cur_exit)
+                continue;
+            std::vector<std::pair<Operand, Operand>> moves;
+            for (auto vr : succ->live_in) {
+                auto from = locationAt(vr, blk_pos[blk].second - 1);
+                auto to = locationAt(vr, blk_pos[succ].first);
+                if (!sameLocation(from, to))
+                    moves.push_back({from, to});
+            }
+            if (moves.empty())
+                continue;
+            std::vector<Operation *> ops;
+            emitMoves(moves, ops);
+
+            auto last = blk->ops.empty() ? nullptr : blk->ops.back();
+            if (outs.size() == 1 && !(last && last->isBrOp())) {
+                // the only successor: moves go to the end of the predecessor
+                for (auto op : ops) {
+                    if (last && last->opt == Operation::JUMP)
+                        last->addBefore(op);
+                    else
+                        blk->addOp(op);
+                }
+            } else if (succ->inBlocks().size() == 1) {
+                // the only predecessor: moves go to the beginning of the successor
+                auto first = succ->ops.empty() ? nullptr : succ->ops.front();
+                for (auto op : ops) {
+                    if (first)
+                        first->addBefore(op);
+                    else
+                        succ->addOp(op);
+                }
+            } else {
+                // critical edge: split it with a new block
+                auto mid = cur_mod->make<BasicBlock>(cur_mod->next_label++);
+                for (auto op : ops)
+                    mid->addOp(op);
+                if (is_fall) {
+                    blk->fall(mid);
+                    mid->fall(succ);
+                    layout.push_back(mid);
+                } else {
+                    assert(last && last->isBrOp() && last->oprs[2].val.bsc_blk == succ);
+                    last->oprs[2] = BB(mid);
+                    succ->jump_in.erase(blk);
+                    blk->jump(mid);
+                    mid->addOp(cur_mod->makeOp(Operation::JUMP, {BB(succ)}));
+                    mid->jump(succ);
+                    tail.push_back(mid);
+                }
+            }
+        }
+    }
+    cur_fun->blocks.clear();
+    for (auto blk : layout)
+        cur_fun->addBlock(blk);
+    for (auto blk : tail)
+        cur_fun->addBlock(blk);
+}
+RALinearScan::Interval *RALinearScan::newInterval(int vr) {
+    auto it = new Interval;
+    it->vr = vr;
+    it->seq = all_itvs.size();
+    all_itvs.push_back(it);
+    return it;
+}
+RALinearScan::Interval *RALinearScan::getInterval(int vr) {
+    auto it = vr2itv.find(vr);
+    if (it == vr2itv.end()) {
+        auto itv = newInterval(vr);
+        itv->top = itv;
+        it = vr2itv.insert({vr, itv}).first;
+    }
+    return it->second;
+}
+RALinearScan::Interval *RALinearScan::split(Interval *it, int pos) {
+    assert(pos > it->start() && pos < it->end());
+    auto child = newInterval(it->vr);
+    child->top = it->top;
+    it->top->children.push_back(child);
+
+    auto &rs = it->ranges;
+    size_t i = 0;
+    while (rs[i].to <= pos)
+        ++i;
+    if (rs[i].from < pos) {
+        child->ranges.push_back({pos, rs[i].to});
+        rs[i].to = pos;
+        ++i;
+    }
+    child->ranges.insert(child->ranges.end(), rs.begin() + i, rs.end());
+    rs.erase(rs.begin() + i, rs.end());
+
+    auto ui = std::lower_bound(it->uses.begin(), it->uses.end(), pos);
+    child->uses.assign(ui, it->uses.end());
+    it->uses.erase(ui, it->uses.end());
+    return child;
+}
+RALinearScan::Interval *RALinearScan::pieceAt(int vr, int pos) {
+    auto top = vr2itv[vr];
+    if (top->covers(pos))
+        return top;
+    for (auto it : top->children) {
+        if (it->covers(pos))
+            return it;
+    }
+    return nullptr;
+}
+Operand RALinearScan::locationAt(int vr, int pos) {
+    auto it = pieceAt(vr, pos);
+    assert(it);
+    if (it->reg != Reg::X0)
+        return PR(it->reg);
+    assert(it->spilled);
+    return FS(getFrmSlt(vr));
+}
+Reg RALinearScan::hintOf(Interval *cur) {
+    if (cur->top != cur) {
+        auto prev = pieceAt(cur->vr, cur->start() - 1);
+        if (prev && prev->reg != Reg::X0)
+            return prev->reg;
+    }
+    auto top = cur->top;
+    if (top->hint_pr != Reg::X0)
+        return top->hint_pr;
+    if (top->hint_vr >= 0 && vr2itv.count(top->hint_vr)) {
+        auto src = pieceAt(top->hint_vr, cur->start() - 1);
+        if (src && src->reg != Reg::X0)
+            return src->reg;
+    }
+    return Reg::X0;
+}
+int RALinearScan::getFrmSlt(int vr) {
+    auto it = vr2slt.find(vr);
+    if (it == vr2slt.end())
+        it = vr2slt.insert({vr, cur_fun->extendFrame(1)}).first;
+    return it->second;
+}
+void RALinearScan::addRange(Interval *it, int from, int to) {
+    // intervals are built backwards, so ranges are kept in descending order here
+    auto &rs = it->ranges;
+    if (!rs.empty() && rs.back().from <= to) {
+        rs.back().from = std::min(rs.back().from, from);
+        rs.back().to = std::max(rs.back().to, to);
+    } else {
+        rs.push_back({from, to});
+    }
+}
+int RALinearScan::intersection(Interval *a, Interval *b) {
+    size_t i = 0, j = 0;
+    while (i < a->ranges.size() && j < b->ranges.size()) {
+        auto &ra = a->ranges[i], &rb = b->ranges[j];
+        int from = std::max(ra.from, rb.from);
+        if (from < std::min(ra.to, rb.to))
+            return from;
+        if (ra.to < rb.to)
+            ++i;
+        else
+            ++j;
+    }
+    return MaxInt();
+}
+void RALinearScan::emitMoves(std::vector<std::pair<Operand, Operand>> moves,
+                             std::vector<Operation *> &out) {
+    auto gen = [&](const Operand &src, const Operand &dst) {
+        if (src.tag == Operand::PHY_REG && dst.tag == Operand::PHY_REG) {
+            out.push_back(cur_mod->makeOp(Operation::MOV, {dst, src}));
+        } else if (src.tag == Operand::PHY_REG) {
+            out.push_back(cur_mod->makeOp(Operation::STORE, {src, dst}));
+        } else {
+            assert(dst.tag == Operand::PHY_REG);
+            out.push_back(cur_mod->makeOp(Operation::LOAD, {src, dst}));
+        }
+    };
+    // sequentialize the parallel move: emit a move once nobody still reads its
+    // destination, break cycles of registers with a scratch slot
+    while (!moves.empty()) {
+        size_t i = 0;
+        for (; i < moves.size(); ++i) {
+            bool blocked = false;
+            for (size_t j = 0; j < moves.size(); ++j) {
+                if (j != i && sameLocation(moves[j].first, moves[i].second))
+                    blocked = true;
+            }
+            if (!blocked)
+                break;
+        }
+        if (i == moves.size()) {
+            auto dst = moves[0].second;
+            if (tmp_slt < 0)
+                tmp_slt = cur_fun->extendFrame(1);
+            gen(dst, FS(tmp_slt));
+            for (auto &m : moves) {
+                if (sameLocation(m.first, dst))
+                    m.first = FS(tmp_slt);
+            }
+            i = 0;
+        }
+        gen(moves[i].first, moves[i].second);
+        moves.erase(moves.begin() + i);
+    }
+}
+
+} // namespace tgr
+} // namespace mc
@@ -0,0 +1,102 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#ifndef __MC_RA_LINEAR_SCAN_HH__
+#define __MC_RA_LINEAR_SCAN_HH__
+
+#include "tgr.hh"
+#include <set>
+#include <array>
+#include <map>
+#include <vector>
+
+namespace mc {
+namespace tgr {
+
+/*
+ * Function-wide linear scan (Wimmer & Franz style) with interval splitting.
+ * Every operation k of the linearized function owns the positions [4k, 4k+4):
+ * 4k is the gap before it (where moves go), 4k+1 is where it reads its operands
+ * and 4k+2 is where it writes its result. Each block starts with an empty
+ * "label" gap so that empty blocks still have a position.
+ */
+class RALinearScan {
+public:
+    void allocate(Module *mod);
+
+private:
+    struct Range {
+        int from, to; // [from, to)
+    };
+    struct Interval {
+        int vr{-1}; // -1 for fixed intervals of physical registers
+        int seq{0};
+        Reg reg{Reg::X0}; // X0 if not assigned to a physical register
+        bool fixed{false};
+        bool spilled{false};
+        std::vector<Range> ranges;
+        std::vector<int> uses;
+        Interval *top{nullptr};
+        std::vector<Interval *> children;
+        Reg hint_pr{Reg::X0};
+        int hint_vr{-1};
+
+        int start() const { return ranges.front().from; }
+        int end() const { return ranges.back().to; }
+        bool covers(int pos) const;
+        int nextUseFrom(int pos) const;
+    };
+    struct IntervalComp {
+        bool operator()(Interval *a, Interval *b) const {
+            return a->start() != b->start() ? a->start() < b->start() : a->seq < b->seq;
+        }
+    };
+
+    Module *cur_mod;
+    Function *cur_fun;
+    BasicBlock *cur_exit;
+
+    std::vector<Interval *> all_itvs;
+    std::map<int, Interval *> vr2itv;
+    std::array<Interval *, RegNum> fixed_itvs;
+    std::map<BasicBlock *, std::pair<int, int>> blk_pos;
+    std::vector<Operation *> gap2op;
+    std::map<int, int> vr2slt;
+    int tmp_slt;
+    std::set<Reg> taint_regs;
+
+    std::set<Interval *, IntervalComp> unhandled;
+    std::vector<Interval *> active, inactive;
+
+    void runOnFunction(Function *fun);
+    void numberOperations();
+    void buildIntervals();
+    void buildFixedIntervals();
+    void linearScan();
+    bool tryAllocateFreeReg(Interval *cur);
+    void allocateBlockedReg(Interval *cur);
+    void splitAndSpill(Interval *it, int pos);
+    void assignRegisters();
+    void resolveSplits();
+    void resolveEdges();
+
+    Interval *newInterval(int vr);
+    Interval *getInterval(int vr);
+    Interval *split(Interval *it, int pos);
+    Interval *pieceAt(int vr, int pos);
+    Operand locationAt(int vr, int pos);
+    Reg hintOf(Interval *cur);
+    int getFrmSlt(int vr);
+
+    static void addRange(Interval *it, int from, int to);
+    static int intersection(Interval *a, Interval *b);
+
+    void emitMoves(std::vector<std::pair<Operand, Operand>> moves,
+                   std::vector<Operation *> &out);
+};
+
+}
+}
+
+#endif //__MC_RA_LINEAR_SCAN_HH__
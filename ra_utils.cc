@@ -0,0 +1,247 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#include "ra_utils.hh"
+#include <algorithm>
+
+namespace mc {
+namespace tgr {
+
+static inline Operand GV(Variable *var) {
+    return Operand::GlbVar(var);
+}
+static inline Operand PR(Reg pr) {
+    return Operand::PhyReg(pr);
+}
+static inline Operand BB(BasicBlock *blk) {
+    return Operand::BscBlk(blk);
+}
+static inline Operand FS(int f) {
+    return Operand::FrmSlt(f);
+}
+
+static void moveOpr2PhyReg(Operation *pos, const Operand &src, Reg pr) {
+    auto mod = pos->block->function->module;
+    Operation *op;
+    if (src.tag == Operand::VIR_REG || src.tag == Operand::INTEGER) {
+        op = mod->makeOp(Operation::MOV, {PR(pr), src});
+    } else if (src.tag == Operand::GLB_VAR) {
+        auto gv = src.val.glb_var;
+        op = mod->makeOp(gv->width > 0 ? Operation::LOAD_ADDR : Operation::LOAD, {GV(gv), PR(pr)});
+    } else {
+        assert(src.tag == Operand::FRM_SLT);
+        op = mod->makeOp(Operation::LOAD_ADDR, {src, PR(pr)});
+    }
+    pos->addBefore(op);
+}
+BasicBlock *lowerPseudoOps(Function *fun) {
+    auto mod = fun->module;
+    auto exit = mod->make<BasicBlock>(mod->next_label++);
+    for (auto blk : fun->blocks) {
+        auto op = blk->ops.empty() ? nullptr : blk->ops.front();
+        while (op) {
+            auto next = op->next();
+            auto &oprs = op->oprs;
+            bool lowered = true;
+            if (op->opt == Operation::__BEGIN_PARAM) {
+                // nothing to do
+            } else if (op->opt == Operation::__SET_PARAM) {
+                moveOpr2PhyReg(op, oprs[0], I2R(oprs[1].val.integer + R2I(Reg::A0)));
+            } else if (op->opt == Operation::__GET_PARAM) {
+                auto ai = I2R(oprs[0].val.integer + R2I(Reg::A0));
+                op->addBefore(mod->makeOp(Operation::MOV, {oprs[1], PR(ai)}));
+            } else if (op->opt == Operation::__GET_RET) {
+                op->addBefore(mod->makeOp(Operation::MOV, {oprs[0], PR(Reg::A0)}));
+            } else if (op->opt == Operation::__SET_RET) {
+                moveOpr2PhyReg(op, oprs[0], Reg::A0);
+                op->addBefore(mod->makeOp(Operation::JUMP, {BB(exit)}));
+                blk->jump(exit);
+            } else {
+                lowered = false;
+            }
+            if (lowered)
+                blk->removeOp(op);
+            op = next;
+        }
+    }
+    auto end_blk = fun->blocks.back();
+    fun->addBlock(exit);
+    assert(!end_blk->fall_out);
+    if (!end_blk->jump_out)
+        end_blk->fall(exit);
+    return exit;
+}
+void removeSelfMoves(Function *fun) {
+    for (auto blk : fun->blocks) {
+        auto op = blk->ops.empty() ? nullptr : blk->ops.front();
+        while (op) {
+            auto next = op->next();
+            auto &oprs = op->oprs;
+            if (op->opt == Operation::MOV && oprs[0].tag == Operand::PHY_REG &&
+                oprs[1].tag == Operand::PHY_REG && oprs[0].val.phy_reg == oprs[1].val.phy_reg)
+                blk->removeOp(op);
+            op = next;
+        }
+    }
+}
+std::vector<std::vector<bool>> dominators(const std::vector<BasicBlock *> &blocks,
+                                          const std::map<BasicBlock *, int> &index,
+                                          const std::set<int> &roots, bool post) {
+    int n = blocks.size();
+    std::vector<std::vector<bool>> dom(n, std::vector<bool>(n, true));
+    for (auto r : roots)
+        dom[r].assign(n, false), dom[r][r] = true;
+    bool changed;
+    do {
+        changed = false;
+        for (int i = 0; i < n; ++i) {
+            if (roots.count(i))
+                continue;
+            std::vector<bool> d(n, true);
+            for (auto b : post ? blocks[i]->outBlocks() : blocks[i]->inBlocks()) {
+                int p = index.at(b);
+                for (int j = 0; j < n; ++j)
+                    d[j] = d[j] && dom[p][j];
+            }
+            d[i] = true;
+            if (d != dom[i])
+                dom[i] = d, changed = true;
+        }
+    } while (changed);
+    return dom;
+}
+std::vector<bool> reachable(const std::vector<BasicBlock *> &blocks,
+                            const std::map<BasicBlock *, int> &index,
+                            const std::set<int> &roots, bool backward) {
+    std::vector<bool> seen(blocks.size(), false);
+    std::vector<int> stk(roots.begin(), roots.end());
+    for (auto r : roots)
+        seen[r] = true;
+    while (!stk.empty()) {
+        auto b = stk.back();
+        stk.pop_back();
+        for (auto next : backward ? blocks[b]->inBlocks() : blocks[b]->outBlocks()) {
+            int i = index.at(next);
+            if (!seen[i])
+                seen[i] = true, stk.push_back(i);
+        }
+    }
+    return seen;
+}
+static bool inCycle(BasicBlock *blk) {
+    std::set<BasicBlock *> seen;
+    std::vector<BasicBlock *> stk = blk->outBlocks();
+    while (!stk.empty()) {
+        auto b = stk.back();
+        stk.pop_back();
+        if (b == blk)
+            return true;
+        if (seen.insert(b).second) {
+            for (auto succ : b->outBlocks())
+                stk.push_back(succ);
+        }
+    }
+    return false;
+}
+static bool touches(Operation *op, Reg pr) {
+    for (auto &opr : op->oprs) {
+        if (opr.tag == Operand::PHY_REG && opr.val.phy_reg == pr)
+            return true;
+    }
+    return false;
+}
+/*
+ * Shrink-wrapping: the save goes to the start of the nearest common dominator
+ * of the blocks using the register and the restore to the end of their nearest
+ * common post-dominator, when the two enclose each other and lie outside of
+ * any cycle. Otherwise the save is at the entry and the restore at the exit.
+ */
+void saveCalleeSavedRegs(Function *fun, BasicBlock *exit, const std::set<Reg> &regs) {
+    auto &blocks = fun->blocks;
+    int n = blocks.size();
+    std::map<BasicBlock *, int> index;
+    std::set<int> exits;
+    for (int i = 0; i < n; ++i) {
+        index[blocks[i]] = i;
+        if (blocks[i]->outBlocks().empty())
+            exits.insert(i); // the exit block, tail calls
+    }
+    auto live = reachable(blocks, index, {0}, false);
+    auto returns = reachable(blocks, index, exits, true);
+    // post-dominance is meaningless for blocks never reaching an exit
+    bool wrap = exits.size() > 0;
+    for (int i = 0; i < n; ++i)
+        wrap = wrap && (!live[i] || returns[i]);
+    std::vector<std::vector<bool>> dom, pdom;
+    if (wrap) {
+        dom = dominators(blocks, index, {0}, false);
+        pdom = dominators(blocks, index, exits, true);
+    }
+
+    for (auto pr : regs) {
+        if (!isCalleeSaved(pr))
+            continue;
+        BasicBlock *save_blk = blocks[0], *restore_blk = exit;
+        std::vector<int> users;
+        for (int i = 0; wrap && i < n; ++i) {
+            if (!live[i] || blocks[i] == exit)
+                continue;
+            for (auto op : blocks[i]->ops) {
+                if (touches(op, pr)) {
+                    users.push_back(i);
+                    break;
+                }
+            }
+        }
+        if (!users.empty()) {
+            // the deepest common (post)dominators have the most (post)dominators
+            int d = -1, p = -1, d_size = 0, p_size = 0;
+            for (int j = 0; j < n; ++j) {
+                bool is_dom = true, is_pdom = true;
+                for (auto u : users)
+                    is_dom = is_dom && dom[u][j], is_pdom = is_pdom && pdom[u][j];
+                int size = std::count(dom[j].begin(), dom[j].end(), true);
+                int p_cnt = std::count(pdom[j].begin(), pdom[j].end(), true);
+                if (is_dom && size > d_size)
+                    d = j, d_size = size;
+                if (is_pdom && p_cnt > p_size)
+                    p = j, p_size = p_cnt;
+            }
+            if (d >= 0 && p >= 0 && blocks[p] != exit && dom[p][d] && pdom[d][p] &&
+                !inCycle(blocks[d]) && !inCycle(blocks[p])) {
+                auto last = blocks[p]->ops.empty() ? nullptr : blocks[p]->ops.back();
+                bool reads = last && last->isBrOp() && touches(last, pr);
+                if (!reads)
+                    save_blk = blocks[d], restore_blk = blocks[p];
+            }
+        }
+
+        auto slt = fun->extendFrame(1);
+        auto save = fun->module->makeOp(Operation::STORE, {PR(pr), FS(slt)});
+        if (save_blk->ops.empty())
+            save_blk->addOp(save);
+        else
+            save_blk->ops.front()->addBefore(save);
+        auto restore = fun->module->makeOp(Operation::LOAD, {FS(slt), PR(pr)});
+        auto last = restore_blk->ops.empty() ? nullptr : restore_blk->ops.back();
+        if (restore_blk != exit && last &&
+            (last->isBrOp() || last->opt == Operation::JUMP || last->opt == Operation::TAIL))
+            last->addBefore(restore);
+        else
+            restore_blk->addOp(restore);
+    }
+}
+void restoreBeforeTailCalls(Function *fun, BasicBlock *exit) {
+    for (auto blk : fun->blocks) {
+        if (blk->ops.empty() || blk->ops.back()->opt != Operation::TAIL)
+            continue;
+        for (auto op : exit->ops) {
+            if (op->opt == Operation::LOAD)
+                blk->ops.back()->addBefore(fun->module->makeOp(Operation::LOAD, op->oprs));
+        }
+    }
+}
+
+}
+}
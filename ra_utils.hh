@@ -0,0 +1,46 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#ifndef __MC_RA_UTILS_HH__
+#define __MC_RA_UTILS_HH__
+
+#include "tgr.hh"
+#include <map>
+#include <set>
+#include <vector>
+
+namespace mc {
+namespace tgr {
+
+/*
+ * Helpers shared by the function-wide allocators (RALinearScan, RAColoring),
+ * saveCalleeSavedRegs and restoreBeforeTailCalls are used by RAGreedy as well.
+ */
+
+// Replace the __xxx pseudo operations with moves from/to the argument registers.
+// Returns the new exit block, which is appended to the function.
+BasicBlock *lowerPseudoOps(Function *fun);
+// Remove "mov r, r" left behind by the allocation.
+void removeSelfMoves(Function *fun);
+// Save the used callee-saved registers and restore them around their uses,
+// at the entry and the exit in the worst case.
+void saveCalleeSavedRegs(Function *fun, BasicBlock *exit, const std::set<Reg> &regs);
+// Tail calls leave without passing the exit, repeat its restores before them.
+void restoreBeforeTailCalls(Function *fun, BasicBlock *exit);
+
+// index maps the blocks to their positions in blocks.
+// Iterative (post)dominators from the given roots, dom[i][j] if j (post)dominates i.
+// Blocks unreachable from the roots are dominated by every block.
+std::vector<std::vector<bool>> dominators(const std::vector<BasicBlock *> &blocks,
+                                          const std::map<BasicBlock *, int> &index,
+                                          const std::set<int> &roots, bool post);
+// Blocks reachable from the roots along the edges, or against them if backward.
+std::vector<bool> reachable(const std::vector<BasicBlock *> &blocks,
+                            const std::map<BasicBlock *, int> &index,
+                            const std::set<int> &roots, bool backward);
+
+}
+}
+
+#endif //__MC_RA_UTILS_HH__
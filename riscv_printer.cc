@@ -32,15 +32,23 @@ void RiscvPrinter::printVariable(Variable *var) {
     os << std::endl;
 }
 void RiscvPrinter::printFunction(Function *fun) {
-    cur_stk = (fun->frame_size / 4 + 1) * 16;
+    save_ra = false;
+    for (auto blk: fun->blocks) {
+        for (auto op: blk->ops)
+            save_ra = save_ra || op->opt == Operation::CALL;
+    }
+    // the slots, then ra at the top, rounded up to 16 bytes
+    cur_stk = ((fun->frame_size + (save_ra ? 1 : 0)) * 4 + 15) / 16 * 16;
     const auto &fn = fun->name;
     os << "\t.text" << std::endl;
     os << "\t.align\t2" << std::endl;
     os << "\t.global\t" << fn << std::endl;
     os << "\t.type\t" << fn << ", @function" << std::endl;
     os << fn << ":" << std::endl;
-    os << "\taddi\tsp, sp, " << -cur_stk << std::endl;
-    os << "\tsw\tra, " << (cur_stk - 4) << "(sp)" << std::endl;
+    if (cur_stk)
+        os << "\taddi\tsp, sp, " << -cur_stk << std::endl;
+    if (save_ra)
+        os << "\tsw\tra, " << (cur_stk - 4) << "(sp)" << std::endl;
     for (auto blk: fun->blocks)
         printBasicBlock(blk);
     os << "\t.size\t" << fn << ", .-" << fn << std::endl;
@@ -65,6 +73,7 @@ void RiscvPrinter::printOperation(Operation *op) {
             when(Operation::IDX_ST, printIdxSt(op);)
             when(Operation::JUMP, printJump(op);)
             when(Operation::CALL, printCall(op);)
+            when(Operation::TAIL, printTail(op);)
             when(Operation::STORE, printStore(op);)
             when(Operation::LOAD, printLoad(op);)
             when(Operation::LOAD_ADDR, printLoadAddr(op);)
@@ -80,12 +89,20 @@ void RiscvPrinter::printBinOp(Operation *op) {
     (void) r2;
     switch (op->opt) {
         when(Operation::BIN_EQ, {
-            gen("xor", oprs);
-            gen("seqz", {r1, r1});
+            if (r3.tag == Operand::INTEGER && r3.val.integer == 0) {
+                gen("seqz", {r1, r2});
+            } else {
+                gen(r3.tag == Operand::INTEGER ? "xori" : "xor", oprs);
+                gen("seqz", {r1, r1});
+            }
         })
         when(Operation::BIN_NE, {
-            gen("xor", oprs);
-            gen("snez", {r1, r1});
+            if (r3.tag == Operand::INTEGER && r3.val.integer == 0) {
+                gen("snez", {r1, r2});
+            } else {
+                gen(r3.tag == Operand::INTEGER ? "xori" : "xor", oprs);
+                gen("snez", {r1, r1});
+            }
         })
         when(Operation::BIN_LT, {
             if (r3.tag == Operand::INTEGER) {
@@ -95,15 +112,33 @@ void RiscvPrinter::printBinOp(Operation *op) {
             }
         })
         when(Operation::BIN_GT, {
-            gen("sgt", oprs);
+            if (r3.tag == Operand::INTEGER) {
+                // x > c  <=>  !(x < c + 1)
+                gen("slti", {r1, r2, Operand::Integer(r3.val.integer + 1)});
+                gen("xori", {r1, r1, Operand::Integer(1)});
+            } else {
+                gen("sgt", oprs);
+            }
         })
         when(Operation::BIN_OR, {
-            gen("or", oprs);
-            gen("snez", {r1, r1});
+            if (r3.tag == Operand::INTEGER && r3.val.integer != 0) {
+                gen("li", {r1, Operand::Integer(1)});
+            } else if (r3.tag == Operand::INTEGER) {
+                gen("snez", {r1, r2});
+            } else {
+                gen("or", oprs);
+                gen("snez", {r1, r1});
+            }
         })
         when(Operation::BIN_AND, {
-            gen("mul", oprs);
-            gen("snez", {r1, r1});
+            if (r3.tag == Operand::INTEGER && r3.val.integer != 0) {
+                gen("snez", {r1, r2});
+            } else if (r3.tag == Operand::INTEGER) {
+                gen("li", {r1, Operand::Integer(0)});
+            } else {
+                gen("mul", oprs);
+                gen("snez", {r1, r1});
+            }
         })
         when(Operation::BIN_ADD, {
             if (r3.tag == Operand::INTEGER) {
@@ -124,6 +159,9 @@ void RiscvPrinter::printBinOp(Operation *op) {
         when(Operation::BIN_REM, {
             gen("rem", oprs);
         })
+        when(Operation::BIN_SHL, {
+            gen("slli", oprs);
+        })
         default:
             assert(false);
     }
@@ -172,6 +210,12 @@ void RiscvPrinter::printBrOp(Operation *op) {
         when(Operation::BR_GT, {
             gen("bgt", oprs);
         })
+        when(Operation::BR_GE, {
+            gen("bge", oprs);
+        })
+        when(Operation::BR_LE, {
+            gen("ble", oprs);
+        })
         default:
             assert(false);
     }
@@ -182,6 +226,16 @@ void RiscvPrinter::printJump(Operation *op) {
 void RiscvPrinter::printCall(Operation *op) {
     gen("call", {op->oprs[0]});
 }
+void RiscvPrinter::printEpilogue() {
+    if (save_ra)
+        os << "\tlw\tra, " << (cur_stk - 4) << "(sp)" << std::endl;
+    if (cur_stk)
+        os << "\taddi\tsp, sp, " << cur_stk << std::endl;
+}
+void RiscvPrinter::printTail(Operation *op) {
+    printEpilogue();
+    gen("tail", {op->oprs[0]});
+}
 void RiscvPrinter::printStore(Operation *op) {
     auto reg = op->oprs[0], slt = op->oprs[1];
     assert(slt.tag == Operand::FRM_SLT);
@@ -211,8 +265,7 @@ void RiscvPrinter::printLoadAddr(Operation *op) {
     }
 }
 void RiscvPrinter::printRet(Operation *op) {
-    os << "\tlw\tra, " << (cur_stk - 4) << "(sp)" << std::endl;
-    os << "\taddi\tsp, sp, " << cur_stk << std::endl;
+    printEpilogue();
     os << "\tjr\tra" << std::endl;
 }
 void RiscvPrinter::gen(const char *opt, std::array<Operand, 3> oprs) {
@@ -19,6 +19,7 @@ public:
 private:
     std::ostream &os;
     int cur_stk{0};
+    bool save_ra{false}; // only functions making calls
 
     void printVariable(Variable *var);
     void printFunction(Function *fun);
@@ -33,10 +34,12 @@ private:
     void printBrOp(Operation *op);
     void printJump(Operation *op);
     void printCall(Operation *op);
+    void printTail(Operation *op);
     void printStore(Operation *op);
     void printLoad(Operation *op);
     void printLoadAddr(Operation *op);
     void printRet(Operation *op);
+    void printEpilogue();
 
     void printOperand(Operand opr);
     void gen(const char *opt, std::array<Operand, 3> oprs);
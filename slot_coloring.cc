@@ -0,0 +1,171 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#include "slot_coloring.hh"
+#include <algorithm>
+#include <cassert>
+
+namespace mc {
+namespace tgr {
+
+// the slot an operation reaches and whether it writes it, -1 if none
+static int slotOf(Operation *op, bool &def) {
+    def = op->opt == Operation::STORE;
+    if (op->opt == Operation::STORE && op->oprs[1].tag == Operand::FRM_SLT)
+        return op->oprs[1].val.frm_slt;
+    if ((op->opt == Operation::LOAD || op->opt == Operation::LOAD_ADDR) &&
+        op->oprs[0].tag == Operand::FRM_SLT)
+        return op->oprs[0].val.frm_slt;
+    return -1;
+}
+
+void SlotColoring::optimize(Module *mod) {
+    stats.clear();
+    for (auto fun: mod->funcs)
+        runOnFunction(fun);
+}
+void SlotColoring::report(std::ostream &os) const {
+    for (auto &st: stats)
+        os << "f_" << st.name << ": frame size " << st.before << " -> " << st.after << std::endl;
+}
+void SlotColoring::runOnFunction(Function *fun) {
+    collectSlots(fun);
+    computeLiveness(fun);
+    buildInterference(fun);
+    auto color = colorSlots();
+
+    int colors = 0;
+    for (auto &c: color)
+        colors = std::max(colors, c.second + 1);
+    std::map<int, int> new_slot = color;
+    int size = colors;
+    for (auto &a: arrays)
+        new_slot[a.first] = size, size += a.second;
+
+    for (auto blk: fun->blocks) {
+        for (auto op: blk->ops) {
+            bool def;
+            int slt = slotOf(op, def);
+            if (slt >= 0)
+                op->oprs[op->opt == Operation::STORE ? 1 : 0] = Operand::FrmSlt(new_slot.at(slt));
+        }
+    }
+    stats.push_back({fun->name, fun->frame_size, size});
+    fun->frame_size = size;
+}
+void SlotColoring::collectSlots(Function *fun) {
+    scalars.clear(), arrays.clear(), accesses.clear();
+    std::set<int> bases;
+    for (auto blk: fun->blocks) {
+        for (auto op: blk->ops) {
+            bool def;
+            int slt = slotOf(op, def);
+            if (slt < 0)
+                continue;
+            ++accesses[slt];
+            if (op->opt == Operation::LOAD_ADDR)
+                bases.insert(slt);
+            else
+                scalars.insert(slt);
+        }
+    }
+    // an array spans up to the next slot in use
+    for (auto b: bases) {
+        assert(!scalars.count(b));
+        auto it = scalars.upper_bound(b);
+        int end = it == scalars.end() ? fun->frame_size : *it;
+        auto next = bases.upper_bound(b);
+        if (next != bases.end())
+            end = std::min(end, *next);
+        arrays[b] = end - b;
+    }
+}
+void SlotColoring::computeLiveness(Function *fun) {
+    live_in.clear(), live_out.clear();
+    std::map<BasicBlock *, std::set<int>> gen, kill;
+    for (auto blk: fun->blocks) {
+        auto &g = gen[blk], &k = kill[blk];
+        for (auto op: blk->ops) {
+            bool def;
+            int slt = slotOf(op, def);
+            if (slt < 0 || !scalars.count(slt))
+                continue;
+            if (def)
+                k.insert(slt);
+            else if (!k.count(slt))
+                g.insert(slt);
+        }
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (BasicBlock *blk: reverse(fun->blocks)) {
+            std::set<int> out;
+            for (auto succ: blk->outBlocks())
+                out.insert(live_in[succ].begin(), live_in[succ].end());
+            auto in = gen[blk];
+            for (auto s: out) {
+                if (!kill[blk].count(s))
+                    in.insert(s);
+            }
+            live_out[blk].swap(out);
+            if (in != live_in[blk])
+                live_in[blk].swap(in), changed = true;
+        }
+    }
+}
+// a store interferes with every other slot live after it
+void SlotColoring::buildInterference(Function *fun) {
+    adj.clear();
+    auto interfere = [this](int a, int b) {
+        if (a != b)
+            adj[a].insert(b), adj[b].insert(a);
+    };
+    // read before written on some path, as if all stored at the entry
+    auto &entry_live = live_in[fun->blocks.front()];
+    for (auto a: entry_live) {
+        for (auto b: entry_live)
+            interfere(a, b);
+    }
+    for (auto blk: fun->blocks) {
+        auto live = live_out[blk];
+        for (Operation *op: reverse(blk->ops)) {
+            bool def;
+            int slt = slotOf(op, def);
+            if (slt < 0 || !scalars.count(slt))
+                continue;
+            if (def) {
+                for (auto s: live)
+                    interfere(slt, s);
+                live.erase(slt);
+            } else {
+                live.insert(slt);
+            }
+        }
+    }
+}
+// first fit, most accessed slots first so they get the lowest offsets
+std::map<int, int> SlotColoring::colorSlots() {
+    std::vector<int> order(scalars.begin(), scalars.end());
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return accesses[a] > accesses[b];
+    });
+    std::map<int, int> color;
+    for (auto s: order) {
+        std::set<int> used;
+        for (auto n: adj[s]) {
+            auto it = color.find(n);
+            if (it != color.end())
+                used.insert(it->second);
+        }
+        int c = 0;
+        while (used.count(c))
+            ++c;
+        color[s] = c;
+    }
+    return color;
+}
+
+}
+}
@@ -0,0 +1,52 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#ifndef __MC_SLOT_COLORING_HH__
+#define __MC_SLOT_COLORING_HH__
+
+#include "tgr.hh"
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace mc {
+namespace tgr {
+
+/*
+ * Shares frame slots after register allocation. Slots only reached by
+ * load/store (spills and callee-saved registers) get live ranges, and slots
+ * that are never live at the same time are colored onto one word. Arrays
+ * (slots whose address is taken) keep their size and follow the shared slots.
+ */
+class SlotColoring {
+public:
+    void optimize(Module *mod);
+    void report(std::ostream &os) const;
+
+private:
+    struct Stat {
+        std::string name;
+        int before, after;
+    };
+
+    void runOnFunction(Function *fun);
+    void collectSlots(Function *fun);
+    void computeLiveness(Function *fun);
+    void buildInterference(Function *fun);
+    std::map<int, int> colorSlots();
+
+    std::set<int> scalars;
+    std::map<int, int> arrays; // base slot -> width
+    std::map<int, int> accesses;
+    std::map<BasicBlock *, std::set<int>> live_in, live_out;
+    std::map<int, std::set<int>> adj;
+    std::vector<Stat> stats;
+};
+
+}
+}
+
+#endif //__MC_SLOT_COLORING_HH__
@@ -0,0 +1,18 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#include "symbol.hh"
+
+namespace mc {
+
+SymbolTable symbols;
+
+Symbol SymbolTable::intern(const std::string &s) {
+    auto it = ids.emplace(s, (Symbol) names.size());
+    if (it.second)
+        names.push_back(&it.first->first);
+    return it.first->second;
+}
+
+}
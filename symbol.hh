@@ -0,0 +1,89 @@
+//
+// Created by agent on 2026/10/18.
+//
+
+#ifndef __MC_SYMBOL_HH__
+#define __MC_SYMBOL_HH__
+
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mc {
+
+// dense id of an interned identifier
+using Symbol = int;
+
+/*
+ * Interns identifiers once in the lexer, so that later passes compare
+ * and index names by Symbol. Names live as long as the table.
+ */
+class SymbolTable {
+public:
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable &) = delete;
+    SymbolTable &operator=(const SymbolTable &) = delete;
+
+    Symbol intern(const std::string &s);
+    const std::string &name(Symbol sym) const { return *names[sym]; }
+    size_t size() const { return names.size(); }
+
+private:
+    std::unordered_map<std::string, Symbol> ids;
+    std::vector<const std::string *> names; // keys of ids, stable across rehashing
+};
+
+extern SymbolTable symbols;
+
+/*
+ * Nested scopes of Symbol -> T in one flat array indexed by Symbol.
+ * bind() logs the binding it shadows, leave() restores the log back to
+ * the mark of the scope. T() stands for unbound.
+ */
+template<typename T>
+class ScopeTable {
+public:
+    void enter() { marks.push_back(log.size()); }
+    void leave() {
+        assert(!marks.empty());
+        for (; log.size() > marks.back(); log.pop_back())
+            slots[log.back().sym] = log.back().old;
+        marks.pop_back();
+    }
+    void clear() { slots.clear(), log.clear(), marks.clear(); }
+
+    void bind(Symbol sym, T val) {
+        assert(!marks.empty());
+        if (sym >= (int) slots.size())
+            slots.resize(sym + 1, Slot{T(), 0});
+        log.push_back({sym, slots[sym]});
+        slots[sym] = {val, (int) marks.size()};
+    }
+    T lookup(Symbol sym) const {
+        return sym < (int) slots.size() ? slots[sym].val : T();
+    }
+    // only the bindings of the innermost scope
+    T lookupLocal(Symbol sym) const {
+        return sym < (int) slots.size() && slots[sym].depth == (int) marks.size() ? slots[sym].val : T();
+    }
+
+private:
+    struct Slot {
+        T val;
+        int depth; // of the scope binding val
+    };
+    struct Undo {
+        Symbol sym;
+        Slot old;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<Undo> log;
+    std::vector<size_t> marks;
+};
+
+}
+
+#endif //__MC_SYMBOL_HH__
@@ -0,0 +1,70 @@
+// 28 values live across a loop and feeding each other, more than fit in
+// registers: the spilled ones are loaded and stored around v_i = v_i + v_i+1
+int putint(int x);
+int a[28];
+int main() {
+    int v0; int v1; int v2; int v3; int v4; int v5; int v6; int v7; int v8; int v9; int v10; int v11; int v12; int v13; int v14; int v15; int v16; int v17; int v18; int v19; int v20; int v21; int v22; int v23; int v24; int v25; int v26; int v27; int i;
+    i = 0;
+    while (i < 28) { a[i] = i * 7 + 3; i = i + 1; }
+    v0 = a[0]; v1 = a[1]; v2 = a[2]; v3 = a[3]; v4 = a[4]; v5 = a[5]; v6 = a[6]; v7 = a[7]; v8 = a[8]; v9 = a[9]; v10 = a[10]; v11 = a[11]; v12 = a[12]; v13 = a[13]; v14 = a[14]; v15 = a[15]; v16 = a[16]; v17 = a[17]; v18 = a[18]; v19 = a[19]; v20 = a[20]; v21 = a[21]; v22 = a[22]; v23 = a[23]; v24 = a[24]; v25 = a[25]; v26 = a[26]; v27 = a[27];
+    i = 0;
+    while (i < 10) {
+        v0 = v0 + v1;
+        v1 = v1 + v2;
+        v2 = v2 + v3;
+        v3 = v3 + v4;
+        v4 = v4 + v5;
+        v5 = v5 + v6;
+        v6 = v6 + v7;
+        v7 = v7 + v8;
+        v8 = v8 + v9;
+        v9 = v9 + v10;
+        v10 = v10 + v11;
+        v11 = v11 + v12;
+        v12 = v12 + v13;
+        v13 = v13 + v14;
+        v14 = v14 + v15;
+        v15 = v15 + v16;
+        v16 = v16 + v17;
+        v17 = v17 + v18;
+        v18 = v18 + v19;
+        v19 = v19 + v20;
+        v20 = v20 + v21;
+        v21 = v21 + v22;
+        v22 = v22 + v23;
+        v23 = v23 + v24;
+        v24 = v24 + v25;
+        v25 = v25 + v26;
+        v26 = v26 + v27;
+        i = i + 1;
+    }
+    putint(v0);
+    putint(v1);
+    putint(v2);
+    putint(v3);
+    putint(v4);
+    putint(v5);
+    putint(v6);
+    putint(v7);
+    putint(v8);
+    putint(v9);
+    putint(v10);
+    putint(v11);
+    putint(v12);
+    putint(v13);
+    putint(v14);
+    putint(v15);
+    putint(v16);
+    putint(v17);
+    putint(v18);
+    putint(v19);
+    putint(v20);
+    putint(v21);
+    putint(v22);
+    putint(v23);
+    putint(v24);
+    putint(v25);
+    putint(v26);
+    putint(v27);
+    return 0;
+}
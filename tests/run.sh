@@ -0,0 +1,23 @@
+#!/bin/bash
+# usage: tests/run.sh [compiler]
+# Compiles every tests/*.c with each register allocator, runs it on rvsim.py
+# and compares the putint output with tests/*.out.
+DIR=$(cd "$(dirname "$0")" && pwd)
+CC=$(realpath "${1:-$DIR/../riscv64C}")
+WORK=$(mktemp -d)
+trap 'rm -rf $WORK' EXIT
+fail=0
+for src in "$DIR"/*.c; do
+    name=$(basename "$src" .c)
+    for ra in greedy linear color; do
+        if ! (cd "$WORK" && timeout 20 "$CC" -ra=$ra "$src" > $name.s); then
+            echo "$name -ra=$ra: compile failed"; fail=1; continue
+        fi
+        got=$(python3 "$DIR/rvsim.py" "$WORK/$name.s" 2>/dev/null | head -1)
+        if [ "$got" != "$(cat "$DIR/$name.out")" ]; then
+            echo "$name -ra=$ra: wrong output"; fail=1; continue
+        fi
+        echo "$name -ra=$ra: ok"
+    done
+done
+exit $fail
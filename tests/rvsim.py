@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""Interpreter for the subset of RV64 assembly printed by riscv64C, for the tests.
+usage: rvsim.py file.s [getint inputs...]
+Prints the putint output and the return value, and to stderr the number of
+executed instructions, loads and stores."""
+import sys, re
+M32 = 0xffffffff
+def s32(x):
+    x &= M32
+    return x - (1 << 32) if x & 0x80000000 else x
+REGS = ['x0','zero','ra','sp','s0','s1','s2','s3','s4','s5','s6','s7','s8','s9','s10','s11',
+        't0','t1','t2','t3','t4','t5','t6','a0','a1','a2','a3','a4','a5','a6','a7','fp']
+def run(path, inputs, maxsteps=200000000):
+    lines = open(path).read().split('\n')
+    insts = []; labels = {}; gaddr = {}; mem = {}
+    next_g = 0x10000
+    pending = None
+    for ln in lines:
+        ln = ln.split('#')[0].strip()
+        if not ln: continue
+        if ln.endswith(':'):
+            name = ln[:-1]
+            labels[name] = len(insts); pending = name
+            continue
+        parts = ln.split(None, 1)
+        op = parts[0]; args = [a.strip() for a in parts[1].split(',')] if len(parts) > 1 else []
+        if op == '.comm':
+            gaddr[args[0]] = next_g; next_g += int(args[1]) + 16; continue
+        if op == '.word':
+            gaddr[pending] = next_g; mem[next_g] = int(args[0]); next_g += 16; continue
+        if op.startswith('.'): continue
+        insts.append((op, args))
+    R = {r: 0 for r in REGS}
+    SP0 = 0x7ff00000
+    R['sp'] = SP0; R['ra'] = -1
+    inp = list(inputs); out = []
+    cnt = {}
+    def val(a):
+        return R[a]
+    def setr(a, v):
+        if a in ('x0', 'zero'): return
+        R[a] = s32(v) if a != 'sp' else v
+    def addr_of(a):
+        m = re.match(r'(-?\d+)\((\w+)\)$', a)
+        if m: return int(m.group(1)) + R[m.group(2)]
+        m = re.match(r'%lo\((\w+)\)\((\w+)\)$', a)
+        if m: return R[m.group(2)]
+        raise Exception('bad addr ' + a)
+    def imm(a):
+        m = re.match(r'%hi\((\w+)\)$', a)
+        if m: return gaddr[m.group(1)]
+        m = re.match(r'%lo\((\w+)\)$', a)
+        if m: return 0
+        return int(a)
+    pc = labels['main']; steps = 0
+    callstack_depth = 0; min_sp = SP0
+    while True:
+        if pc == -1: break
+        op, a = insts[pc]; pc += 1; steps += 1
+        if steps > maxsteps: raise Exception('timeout')
+        cnt[op] = cnt.get(op, 0) + 1
+        if op == 'addi': setr(a[0], val(a[1]) + imm(a[2]))
+        elif op == 'add': setr(a[0], val(a[1]) + val(a[2]))
+        elif op == 'sub': setr(a[0], val(a[1]) - val(a[2]))
+        elif op == 'mul': setr(a[0], val(a[1]) * val(a[2]))
+        elif op in ('div', 'rem'):
+            x, y = val(a[1]), val(a[2])
+            if y == 0: raise Exception('div by zero')
+            q = abs(x) // abs(y) * (1 if (x >= 0) == (y >= 0) else -1)
+            setr(a[0], q if op == 'div' else x - q * y)
+        elif op == 'slt': setr(a[0], 1 if val(a[1]) < val(a[2]) else 0)
+        elif op == 'slti': setr(a[0], 1 if val(a[1]) < imm(a[2]) else 0)
+        elif op == 'sltu': setr(a[0], 1 if (val(a[1]) & M32) < (val(a[2]) & M32) else 0)
+        elif op == 'sltiu': setr(a[0], 1 if (val(a[1]) & M32) < (imm(a[2]) & M32) else 0)
+        elif op == 'sgt': setr(a[0], 1 if val(a[1]) > val(a[2]) else 0)
+        elif op == 'xor': setr(a[0], val(a[1]) ^ val(a[2]))
+        elif op == 'xori': setr(a[0], val(a[1]) ^ imm(a[2]))
+        elif op == 'or': setr(a[0], val(a[1]) | val(a[2]))
+        elif op == 'ori': setr(a[0], val(a[1]) | imm(a[2]))
+        elif op == 'and': setr(a[0], val(a[1]) & val(a[2]))
+        elif op == 'andi': setr(a[0], val(a[1]) & imm(a[2]))
+        elif op == 'sll': setr(a[0], val(a[1]) << (val(a[2]) & 31))
+        elif op == 'slli': setr(a[0], val(a[1]) << imm(a[2]))
+        elif op == 'sra': setr(a[0], val(a[1]) >> (val(a[2]) & 31))
+        elif op == 'srai': setr(a[0], val(a[1]) >> imm(a[2]))
+        elif op == 'seqz': setr(a[0], 1 if val(a[1]) == 0 else 0)
+        elif op == 'snez': setr(a[0], 1 if val(a[1]) != 0 else 0)
+        elif op == 'neg': setr(a[0], -val(a[1]))
+        elif op == 'not': setr(a[0], ~val(a[1]))
+        elif op == 'li': setr(a[0], int(a[1]))
+        elif op == 'mv': setr(a[0], val(a[1]))
+        elif op == 'lui': setr(a[0], imm(a[1]))
+        elif op == 'lw':
+            ad = addr_of(a[1]); setr(a[0], mem.get(ad, 0))
+        elif op == 'sw':
+            ad = addr_of(a[1]); mem[ad] = s32(val(a[0]))
+            if R['sp'] < min_sp: min_sp = R['sp']
+        elif op in ('beq', 'bne', 'blt', 'bgt', 'bge', 'ble', 'bltu', 'bgeu'):
+            x, y = val(a[0]), val(a[1])
+            t = {'beq': x == y, 'bne': x != y, 'blt': x < y, 'bgt': x > y, 'bge': x >= y, 'ble': x <= y,
+                 'bltu': (x & M32) < (y & M32), 'bgeu': (x & M32) >= (y & M32)}[op]
+            if t: pc = labels[a[2]]
+        elif op in ('beqz', 'bnez', 'bltz', 'bgez', 'blez', 'bgtz'):
+            x = val(a[0])
+            t = {'beqz': x == 0, 'bnez': x != 0, 'bltz': x < 0, 'bgez': x >= 0, 'blez': x <= 0, 'bgtz': x > 0}[op]
+            if t: pc = labels[a[1]]
+        elif op == 'j': pc = labels[a[0]]
+        elif op in ('call', 'tail'):
+            f = a[0]
+            if f in ('getint', 'putint', 'getchar', 'putchar'):
+                if f == 'getint': setr('a0', inp.pop(0) if inp else 0)
+                elif f == 'getchar': setr('a0', inp.pop(0) if inp else -1)
+                elif f == 'putint': out.append(str(val('a0')))
+                else: out.append(chr(val('a0')))
+                for r in ['t0','t1','t2','t3','t4','t5','t6','a1','a2','a3','a4','a5','a6','a7']:
+                    R[r] = 0x5a5a5a5a  # clobber caller-saved
+                if op == 'tail': pc = R['ra']
+            else:
+                if op == 'call': R['ra'] = pc
+                pc = labels[f]
+            if R['sp'] < min_sp: min_sp = R['sp']
+        elif op == 'jr': pc = R[a[0]]
+        elif op == 'ret': pc = R['ra']
+        else: raise Exception('unknown op ' + op)
+        if R['sp'] < min_sp: min_sp = R['sp']
+    return out, R['a0'], steps, cnt, SP0 - min_sp
+if __name__ == '__main__':
+    out, ret, steps, cnt, stk = run(sys.argv[1], [int(x) for x in sys.argv[2:]])
+    print(' '.join(out))
+    print('ret', ret)
+    print('steps', steps, 'lw', cnt.get('lw', 0), 'sw', cnt.get('sw', 0), 'stack', stk, file=sys.stderr)
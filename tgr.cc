@@ -94,7 +94,7 @@ std::ostream &operator<<(std::ostream &os, const Operand &opr) {
 std::ostream &operator<<(std::ostream &os, const Operation &op) {
     if (op.isBinOp()) {
         os << op.oprs[0] << " = " << op.oprs[1] << " ";
-        os << BinaryExpr::OpStr[static_cast<int>(op.opt)] << " ";
+        os << (op.opt == Operation::BIN_SHL ? "<<" : BinaryExpr::OpStr[static_cast<int>(op.opt)]) << " ";
         os << op.oprs[2];
     } else if (op.isUnOp()) {
         os << op.oprs[0] << " = ";
@@ -102,8 +102,11 @@ std::ostream &operator<<(std::ostream &os, const Operation &op) {
         os << op.oprs[1];
     } else if (op.isBrOp()) {
         os << "if " << op.oprs[0] << " ";
-        os << BinaryExpr::OpStr[static_cast<int>(op.opt - Operation::BR_EQ + Operation::BIN_EQ)]
-           << " ";
+        if (op.opt == Operation::BR_GE || op.opt == Operation::BR_LE)
+            os << (op.opt == Operation::BR_GE ? ">=" : "<=") << " ";
+        else
+            os << BinaryExpr::OpStr[static_cast<int>(op.opt - Operation::BR_EQ + Operation::BIN_EQ)]
+               << " ";
         os << op.oprs[1] << " goto " << op.oprs[2];
     } else {
         switch (op.opt) {
@@ -122,6 +125,9 @@ std::ostream &operator<<(std::ostream &os, const Operation &op) {
             when(Operation::CALL, {
                 os << "call f_" << op.oprs[0];
             })
+            when(Operation::TAIL, {
+                os << "tail f_" << op.oprs[0];
+            })
             when(Operation::STORE, {
                 os << "store " << op.oprs[0] << " " << op.oprs[1];
             })
@@ -182,9 +188,24 @@ Operand Operand::FrmSlt(int f) {
 Operand Operand::Integer(int i) {
     return {INTEGER, i};
 }
-Operand Operand::FuncName(const std::string &name) {
+Operand Operand::FuncName(const std::string *name) {
     return Operand(name);
 }
+void printFrameAccesses(std::ostream &os, const Module &mod) {
+    for (auto func: mod.funcs) {
+        int loads = 0, stores = 0;
+        for (auto blk: func->blocks) {
+            for (auto op: blk->ops) {
+                if (op->opt == Operation::LOAD && op->oprs[0].tag == Operand::FRM_SLT)
+                    ++loads;
+                else if (op->opt == Operation::STORE && op->oprs[1].tag == Operand::FRM_SLT)
+                    ++stores;
+            }
+        }
+        os << "f_" << func->name << ": " << loads << " frame loads, "
+           << stores << " frame stores, frame size " << func->frame_size << std::endl;
+    }
+}
 void Module::addVar(Variable *var) {
     var->module = this;
     vars.push_back(var);
@@ -227,38 +248,31 @@ std::vector<BasicBlock *> BasicBlock::inBlocks() {
     return ret;
 }
 void BasicBlock::addOp(Operation *op) {
-    op->link = ops.insert(ops.end(), op);
+    ops.push_back(op);
     op->block = this;
 }
 void BasicBlock::addOp(Operation::Opt opt, std::array<Operand, 3> opr) {
-    addOp(new Operation(opt, opr));
+    assert(function);
+    addOp(function->module->makeOp(opt, opr));
 }
 Operation *BasicBlock::prevOpOf(Operation *op) {
-    auto it = op->link;
-    if (it != ops.begin())
-        return *(--it);
-    return nullptr;
+    return op->ilist_prev;
 }
 Operation *BasicBlock::nextOpOf(Operation *op) {
-    auto it = op->link;
-    if (++it != ops.end())
-        return *it;
-    return nullptr;
+    return op->ilist_next;
 }
 void BasicBlock::addOpBefore(Operation *pos, Operation *op) {
     assert(pos->block == this);
-    auto it = pos->link;
-    op->link = ops.insert(it, op);
+    ops.insert(pos, op);
     op->block = this;
 }
 void BasicBlock::addOpAfter(Operation *pos, Operation *op) {
     assert(pos->block == this);
-    auto it = pos->link;
-    op->link = ops.insert(++it, op);
+    ops.insert(pos->ilist_next, op);
     op->block = this;
 }
 void BasicBlock::removeOp(Operation *op) {
-    ops.erase(op->link);
+    ops.erase(op);
     op->block = nullptr;
 }
 Operation *Operation::prev() {
@@ -273,33 +287,40 @@ void Operation::addBefore(Operation *op) {
 void Operation::addAfter(Operation *op) {
     block->addOpAfter(this, op);
 }
-const std::set<int> &Operation::getUsedVirRegs() {
-    if (modified[0]) {
-        modified[0] = false;
-        uses.clear();
-        getDefinedVirRegs();
-        for (size_t i = 0; i < oprs.size(); ++i) {
-            if (oprs[i].tag == Operand::VIR_REG && !def_bits[i])
-                uses.insert(oprs[i].val.vir_reg);
-        }
+void VirRegSet::insert(int vr) {
+    int i = cnt;
+    while (i > 0 && regs[i - 1] > vr)
+        --i;
+    if (i > 0 && regs[i - 1] == vr)
+        return;
+    assert(cnt < 3);
+    for (int j = cnt++; j > i; --j)
+        regs[j] = regs[j - 1];
+    regs[i] = vr;
+}
+VirRegSet Operation::getUsedVirRegs() const {
+    VirRegSet uses;
+    int d = getDefinedIndex();
+    for (int i = 0; i < 3; ++i) {
+        if (oprs[i].tag == Operand::VIR_REG && i != d)
+            uses.insert(oprs[i].val.vir_reg);
     }
     return uses;
 }
-const std::set<int> &Operation::getDefinedVirRegs() {
-    if (modified[1]) {
-        modified[1] = false;
-        defs.clear();
-        def_bits.fill(false);
-        if (isUnOp() || isBinOp() || opt == MOV || opt == IDX_LD || opt == __GET_RET) {
-            if (oprs[0].tag == Operand::VIR_REG)
-                defs.insert(oprs[0].val.vir_reg), def_bits[0] = true;
-        } else if (opt == LOAD || opt == LOAD_ADDR || opt == __GET_PARAM) {
-            if (oprs[1].tag == Operand::VIR_REG)
-                defs.insert(oprs[1].val.vir_reg), def_bits[1] = true;
-        }
-    }
+VirRegSet Operation::getDefinedVirRegs() const {
+    VirRegSet defs;
+    int d = getDefinedIndex();
+    if (d >= 0 && oprs[d].tag == Operand::VIR_REG)
+        defs.insert(oprs[d].val.vir_reg);
     return defs;
 }
+int Operation::getDefinedIndex() const {
+    if (isUnOp() || isBinOp() || opt == MOV || opt == IDX_LD || opt == __GET_RET)
+        return 0;
+    if (opt == LOAD || opt == LOAD_ADDR || opt == __GET_PARAM)
+        return 1;
+    return -1;
+}
 void Operation::rewrite(int vr, Reg pr) {
     for (auto &opr: oprs) {
         if (opr.tag == Operand::VIR_REG && opr.val.vir_reg == vr)
@@ -10,9 +10,12 @@
 #include <set>
 #include <type_traits>
 #include <array>
+#include <initializer_list>
 #include <string>
 #include <list>
+#include "arena.hh"
 #include "eyr.hh"
+#include "ilist.hh"
 
 namespace mc {
 namespace tgr {
@@ -45,17 +48,6 @@ struct BasicBlock;
 struct Operation;
 struct Operand;
 
-struct Module {
-    std::vector<Variable *> vars;
-    std::vector<Function *> funcs;
-    int next_vir_reg_id{0};
-    int next_label{0};
-    int next_glb_var_id{0};
-
-    void addVar(Variable *var);
-    void addFunc(Function *func);
-};
-
 struct Variable {
     Module *module{nullptr};
     int id;
@@ -90,15 +82,14 @@ struct Operand {
         int frm_slt;
         Variable *glb_var;
         BasicBlock *bsc_blk;
-        std::string *fun_nme;
+        const std::string *fun_nme;
     } val{.integer = 0};
 
     Operand() = default;
     explicit Operand(Reg r) : tag(PHY_REG) { val.phy_reg = r; }
     explicit Operand(Variable *var) : tag(GLB_VAR) { val.glb_var = var; }
     explicit Operand(BasicBlock *blk) : tag(BSC_BLK) { val.bsc_blk = blk; }
-    explicit Operand(std::string fn)
-            : tag(FUN_NME) { val.fun_nme = new std::string(std::move(fn)); }
+    explicit Operand(const std::string *fn) : tag(FUN_NME) { val.fun_nme = fn; }
     Operand(Tag t, int i);
     static Operand PhyReg(Reg r);
     static Operand GlbVar(Variable *v);
@@ -106,40 +97,61 @@ struct Operand {
     static Operand VirReg(int r);
     static Operand FrmSlt(int f);
     static Operand Integer(int i);
-    static Operand FuncName(const std::string &name);
+    static Operand FuncName(const std::string *name); // owned by the module arena
+};
+
+// virtual registers read or written by an operation: sorted, no duplicates
+class VirRegSet {
+public:
+    VirRegSet() = default;
+    VirRegSet(std::initializer_list<int> vrs) {
+        for (auto vr: vrs)
+            insert(vr);
+    }
+    const int *begin() const { return regs; }
+    const int *end() const { return regs + cnt; }
+    bool empty() const { return cnt == 0; }
+    size_t size() const { return cnt; }
+    size_t count(int vr) const {
+        for (int i = 0; i < cnt; ++i) {
+            if (regs[i] == vr)
+                return 1;
+        }
+        return 0;
+    }
+    void insert(int vr);
+
+private:
+    int regs[3];
+    int cnt{0};
 };
 
-struct Operation {
+struct Operation : public IListNode<Operation> {
     BasicBlock *block{nullptr};
-    typename std::list<Operation *>::iterator link;
     enum Opt {
         UN_NEG = 0, UN_NOT,
         BIN_EQ, BIN_NE, BIN_LT, BIN_GT, BIN_OR, BIN_AND,
-        BIN_ADD, BIN_SUB, BIN_MUL, BIN_DIV, BIN_REM,
+        BIN_ADD, BIN_SUB, BIN_MUL, BIN_DIV, BIN_REM, BIN_SHL,
         MOV, IDX_LD, IDX_ST,
-        BR_EQ, BR_NE, BR_LT, BR_GT, BR_OR, BR_AND, JUMP,
-        CALL, STORE, LOAD, LOAD_ADDR, RET,
+        BR_EQ, BR_NE, BR_LT, BR_GT, BR_OR, BR_AND, BR_GE, BR_LE, JUMP,
+        CALL, TAIL, STORE, LOAD, LOAD_ADDR, RET,
         __SET_PARAM, __BEGIN_PARAM, __GET_PARAM, __SET_RET, __GET_RET,
     } opt;
     std::array<Operand, 3> oprs;
 
     Operation(Opt opt, std::array<Operand, 3> opr)
-            : opt(opt), oprs(opr), def_bits({false}) {}
-    inline bool isBinOp() const { return opt >= BIN_EQ && opt <= BIN_REM; }
+            : opt(opt), oprs(opr) {}
+    inline bool isBinOp() const { return opt >= BIN_EQ && opt <= BIN_SHL; }
     inline bool isUnOp() const { return opt >= UN_NEG && opt <= UN_NOT; }
-    inline bool isBrOp() const { return opt >= BR_EQ && opt <= BR_AND; }
+    inline bool isBrOp() const { return opt >= BR_EQ && opt <= BR_LE; }
     Operation *prev();
     Operation *next();
     void addBefore(Operation *op);
     void addAfter(Operation *op);
-    const std::set<int> &getUsedVirRegs();
-    const std::set<int> &getDefinedVirRegs();
+    VirRegSet getUsedVirRegs() const;
+    VirRegSet getDefinedVirRegs() const;
+    int getDefinedIndex() const; // index of the defined operand, -1 if none
     void rewrite(int vr, Reg pr);
-
-private:
-    bool modified[2]{true, true};
-    std::set<int> uses, defs;
-    std::array<bool, 3> def_bits;
 };
 
 
@@ -150,8 +162,8 @@ struct BasicBlock {
     BasicBlock *jump_out{nullptr};
     BasicBlock *fall_in{nullptr};
     std::set<BasicBlock *> jump_in;
-    std::list<Operation *> ops;
-    std::set<int> live_gen, live_kill, live_in, live_out;
+    IList<Operation> ops;
+    std::set<int> live_in, live_out;
 
     explicit BasicBlock(int l) : label(l) {}
 
@@ -170,6 +182,21 @@ struct BasicBlock {
     void removeOp(Operation *op);
 };
 
+struct Module {
+    std::vector<Variable *> vars;
+    std::vector<Function *> funcs;
+    int next_vir_reg_id{0};
+    int next_label{0};
+    int next_glb_var_id{0};
+    Arena arena; // owns the variables, functions, blocks and operations
+
+    template<typename T, typename ...Args>
+    T *make(Args &&...args) { return arena.make<T>(std::forward<Args>(args)...); }
+    Operation *makeOp(Operation::Opt opt, std::array<Operand, 3> oprs) { return make<Operation>(opt, oprs); }
+    void addVar(Variable *var);
+    void addFunc(Function *func);
+};
+
 std::ostream &operator<<(std::ostream &os, const Module &mod);
 
 std::ostream &operator<<(std::ostream &os, const Variable &var);
@@ -182,6 +209,8 @@ std::ostream &operator<<(std::ostream &os, const Operation &op);
 
 std::ostream &operator<<(std::ostream &os, const BasicBlock &blk);
 
+void printFrameAccesses(std::ostream &os, const Module &mod);
+
 };
 };
 
@@ -4,6 +4,8 @@
 
 #include "tgr_emitter.hh"
 #include "tgr.hh"
+#include <algorithm>
+#include <climits>
 
 namespace mc {
 namespace tgr {
@@ -42,10 +44,10 @@ void TgrEmitter::runOnGlobalVar(eyr::Variable *e_var) {
     var2var[e_var] = var;
 }
 void TgrEmitter::runOnFunction(eyr::Function *e_func) {
-    cur_func = new Function(e_func->name, e_func->params.size());
+    cur_func = cur_mod->make<Function>(e_func->name, e_func->params.size());
     cur_mod->addFunc(cur_func);
     for (auto _: e_func->blocks)
-        (void) _, cur_func->addBlock(new BasicBlock(cur_mod->next_label++));
+        (void) _, cur_func->addBlock(cur_mod->make<BasicBlock>(cur_mod->next_label++));
     for (size_t i = 0; i < e_func->blocks.size(); ++i) {
         if (auto blk = e_func->blocks[i]->fall_out)
             cur_func->blocks[i]->fall(cur_func->blocks[blk->f_idx]);
@@ -69,45 +71,74 @@ void TgrEmitter::runOnFunction(eyr::Function *e_func) {
 }
 void TgrEmitter::runOnBlock(eyr::BasicBlock *e_blk) {
     for (auto inst: e_blk->insts)
-        runOnInstruction(inst);
-}
-void TgrEmitter::runOnInstruction(eyr::Instruction *e_inst) {
-    if (auto inst = dynamic_cast<eyr::BinaryInst *>(e_inst)) {
-        emitBinaryInst(inst);
-    } else if (auto inst = dynamic_cast<eyr::UnaryInst *>(e_inst)) {
-        emitUnaryInst(inst);
-    } else if (auto inst = dynamic_cast<eyr::CallInst *>(e_inst)) {
-        emitCallInst(inst);
-    } else if (auto inst = dynamic_cast<eyr::MoveInst *>(e_inst)) {
-        emitMoveInst(inst);
-    } else if (auto inst = dynamic_cast<eyr::StoreInst *>(e_inst)) {
-        emitStoreInst(inst);
-    } else if (auto inst = dynamic_cast<eyr::LoadInst *>(e_inst)) {
-        emitLoadInst(inst);
-    } else if (auto inst = dynamic_cast<eyr::BranchInst *>(e_inst)) {
-        emitBranchInst(inst);
-    } else if (auto inst = dynamic_cast<eyr::JumpInst *>(e_inst)) {
-        emitJumpInst(inst);
-    } else if (auto inst = dynamic_cast<eyr::ReturnInst *>(e_inst)) {
-        emitReturnInst(inst);
-    } else {
-        // cannot touch here
-        assert(false);
+        visit(inst);
+}
+static inline bool isPowerOf2(int x) {
+    return x > 0 && (x & (x - 1)) == 0;
+}
+static inline bool isImm12(int x) {
+    return x >= -2048 && x < 2048;
+}
+// whether "r = r op imm" can be printed without loading imm into a register
+static bool acceptsImm(Operation::Opt opt, int imm) {
+    switch (opt) {
+        case Operation::BIN_ADD:
+        case Operation::BIN_LT:
+        case Operation::BIN_EQ:
+        case Operation::BIN_NE:
+            return isImm12(imm);
+        case Operation::BIN_GT: // slti with imm + 1
+            return imm < INT_MAX && isImm12(imm + 1);
+        case Operation::BIN_AND:
+        case Operation::BIN_OR:
+            return true;
+        default:
+            return false;
     }
 }
-void TgrEmitter::emitBinaryInst(eyr::BinaryInst *inst) {
+void TgrEmitter::visitBinaryInst(eyr::BinaryInst *inst) {
     auto opt = static_cast<Operation::Opt>(inst->opt);
     auto x = inst->dst;
+    auto lhs = inst->lhs, rhs = inst->rhs;
+    // keep the immediate on the right
+    if (lhs.imm && !rhs.imm) {
+        switch (opt) {
+            case Operation::BIN_LT:
+                opt = Operation::BIN_GT, std::swap(lhs, rhs);
+                break;
+            case Operation::BIN_GT:
+                opt = Operation::BIN_LT, std::swap(lhs, rhs);
+                break;
+            case Operation::BIN_EQ:
+            case Operation::BIN_NE:
+            case Operation::BIN_OR:
+            case Operation::BIN_AND:
+            case Operation::BIN_ADD:
+            case Operation::BIN_MUL:
+                std::swap(lhs, rhs);
+                break;
+            default:
+                break;
+        }
+    }
+    if (opt == Operation::BIN_SUB && rhs.imm && rhs.val != INT_MIN)
+        opt = Operation::BIN_ADD, rhs.val = -rhs.val;
     Operand oy, oz;
-    oy = VR(loadOpr(inst->lhs));
-    if (inst->rhs.imm) {
-        if (opt == Operation::BIN_ADD || opt == Operation::BIN_LT) {
-            oz = INT(inst->rhs.val);
+    oy = VR(loadOpr(lhs));
+    if (rhs.imm) {
+        if (acceptsImm(opt, rhs.val)) {
+            oz = INT(rhs.val);
+        } else if (opt == Operation::BIN_MUL && isPowerOf2(rhs.val)) {
+            int shamt = 0;
+            while ((1 << shamt) != rhs.val)
+                ++shamt;
+            opt = Operation::BIN_SHL;
+            oz = INT(shamt);
         } else {
-            oz = VR(loadOpr((inst->rhs)));
+            oz = VR(loadOpr((rhs)));
         }
     } else {
-        oz = VR(loadOpr((inst->rhs)));
+        oz = VR(loadOpr((rhs)));
     }
     if (x->is_global()) {
         auto r1 = allocVR();
@@ -119,7 +150,7 @@ void TgrEmitter::emitBinaryInst(eyr::BinaryInst *inst) {
     }
 
 }
-void TgrEmitter::emitUnaryInst(eyr::UnaryInst *inst) {
+void TgrEmitter::visitUnaryInst(eyr::UnaryInst *inst) {
     auto opt = static_cast<Operation::Opt>(inst->opt);
     auto x = inst->dst;
     auto ry = loadOpr(inst->opr);
@@ -132,7 +163,7 @@ void TgrEmitter::emitUnaryInst(eyr::UnaryInst *inst) {
         gen(opt, {VR(rx), VR(ry)});
     }
 }
-void TgrEmitter::emitCallInst(eyr::CallInst *inst) {
+void TgrEmitter::visitCallInst(eyr::CallInst *inst) {
     assert(inst->args.size() <= 8);
     gen(Operation::__BEGIN_PARAM, {});
     for (size_t i = 0; i < inst->args.size(); ++i) {
@@ -153,13 +184,17 @@ void TgrEmitter::emitCallInst(eyr::CallInst *inst) {
             gen(Operation::__SET_PARAM, {VR(rx), INT(i)});
         }
     }
-    gen(Operation::CALL, {Operand::FuncName(inst->name)});
+    if (inst->tail) {
+        gen(Operation::TAIL, {Operand::FuncName(cur_mod->make<std::string>(inst->name))});
+        return;
+    }
+    gen(Operation::CALL, {Operand::FuncName(cur_mod->make<std::string>(inst->name))});
     auto x = inst->dst;
     assert(x->is_local());
     auto rx = loadVar(x);
     gen(Operation::__GET_RET, {VR(rx)});
 }
-void TgrEmitter::emitMoveInst(eyr::MoveInst *inst) {
+void TgrEmitter::visitMoveInst(eyr::MoveInst *inst) {
     auto x = inst->dst;
     auto s = inst->src;
     if (s.imm) {
@@ -176,38 +211,53 @@ void TgrEmitter::emitMoveInst(eyr::MoveInst *inst) {
         }
     }
 }
-void TgrEmitter::emitStoreInst(eyr::StoreInst *inst) {
-    auto rx = loadAddr(inst->base), ry = loadOpr(inst->idx), rz = loadOpr(inst->src);
-    gen(Operation::BIN_ADD, {VR(rx), VR(rx), VR(ry)});
-    gen(Operation::IDX_ST, {VR(rx), INT(0), VR(rz)});
+void TgrEmitter::visitStoreInst(eyr::StoreInst *inst) {
+    int rx;
+    auto off = loadElemAddr(inst->base, inst->idx, rx);
+    auto rz = loadOpr(inst->src);
+    gen(Operation::IDX_ST, {VR(rx), off, VR(rz)});
 }
-void TgrEmitter::emitLoadInst(eyr::LoadInst *inst) {
+void TgrEmitter::visitLoadInst(eyr::LoadInst *inst) {
     auto x = inst->dst;
-    auto ry = loadAddr(inst->src), rz = loadOpr(inst->idx);
-    gen(Operation::BIN_ADD, {VR(ry), VR(ry), VR(rz)});
+    int ry;
+    auto off = loadElemAddr(inst->src, inst->idx, ry);
     if (x->is_local()) {
         auto rx = loadVar(x);
-        gen(Operation::IDX_LD, {VR(rx), VR(ry), INT(0)});
+        gen(Operation::IDX_LD, {VR(rx), VR(ry), off});
     } else {
         auto rx = allocVR();
-        gen(Operation::IDX_LD, {VR(rx), VR(ry), INT(0)});
+        gen(Operation::IDX_LD, {VR(rx), VR(ry), off});
         storeVar(VR(rx), x);
     }
 }
-void TgrEmitter::emitBranchInst(eyr::BranchInst *inst) {
-    assert(inst->opt == eyr::BranchInst::LgcOp::NE);
-    assert(inst->rhs.imm && inst->rhs.val == 0);
-    auto rx = loadOpr(inst->lhs);
-    gen(Operation::BR_NE, {
-            VR(rx), PR(Reg::X0), BB(cur_func->blocks[inst->dst->f_idx]),
-    });
+void TgrEmitter::visitBranchInst(eyr::BranchInst *inst) {
+    Operation::Opt opt;
+    switch (inst->opt) {
+        when(eyr::BranchInst::LgcOp::EQ, opt = Operation::BR_EQ;)
+        when(eyr::BranchInst::LgcOp::NE, opt = Operation::BR_NE;)
+        when(eyr::BranchInst::LgcOp::LT, opt = Operation::BR_LT;)
+        when(eyr::BranchInst::LgcOp::GT, opt = Operation::BR_GT;)
+        when(eyr::BranchInst::LgcOp::GE, opt = Operation::BR_GE;)
+        when(eyr::BranchInst::LgcOp::LE, opt = Operation::BR_LE;)
+        default:
+            assert(false);
+    }
+    // comparisons against zero use x0
+    auto brOpr = [this](eyr::Operand opr) {
+        return opr.imm && opr.val == 0 ? PR(Reg::X0) : VR(loadOpr(opr));
+    };
+    auto ox = brOpr(inst->lhs), oy = brOpr(inst->rhs);
+    gen(opt, {ox, oy, BB(cur_func->blocks[inst->dst->f_idx])});
 }
-void TgrEmitter::emitJumpInst(eyr::JumpInst *inst) {
+void TgrEmitter::visitJumpInst(eyr::JumpInst *inst) {
     gen(Operation::JUMP, {
             BB(cur_func->blocks[inst->dst->f_idx]),
     });
 }
-void TgrEmitter::emitReturnInst(eyr::ReturnInst *inst) {
+void TgrEmitter::visitReturnInst(eyr::ReturnInst *inst) {
+    auto call = eyr::dyn_cast<eyr::CallInst>(inst->prev());
+    if (call && call->tail)
+        return;
     auto x = inst->opr.var;
     if (x == nullptr) {
         gen(Operation::__SET_RET, {INT(inst->opr.val)});
@@ -226,7 +276,7 @@ int TgrEmitter::allocVR() {
     return cur_mod->next_vir_reg_id++;
 }
 Variable *TgrEmitter::allocGV(int width) {
-    auto var = new Variable(cur_mod->next_glb_var_id++, width);
+    auto var = cur_mod->make<Variable>(cur_mod->next_glb_var_id++, width);
     return var;
 }
 int TgrEmitter::loadVar(eyr::Variable *x) {
@@ -246,7 +296,7 @@ int TgrEmitter::loadAddr(eyr::Variable *x) {
         auto rx = allocVR();
         gen(Operation::LOAD_ADDR, {GV(var2var[x]), VR(rx)});
         return rx;
-    } else if (x->is_param()) {
+    } else if (!x->is_addr()) {
         auto rx = loadVar(x);
         auto rt = allocVR();
         gen(Operation::MOV, {VR(rt), VR(rx)});
@@ -261,6 +311,18 @@ int TgrEmitter::loadAddr(eyr::Variable *x) {
         return rx;
     }
 }
+// base register and offset of base[idx], small constant offsets are folded into lw/sw
+Operand TgrEmitter::loadElemAddr(eyr::Variable *base, eyr::Operand idx, int &rb) {
+    if (idx.imm && isImm12(idx.val)) {
+        // a pointer is not modified, so no copy is needed
+        rb = base->is_local() && !base->is_addr() ? loadVar(base) : loadAddr(base);
+        return INT(idx.val);
+    }
+    rb = loadAddr(base);
+    auto ri = loadOpr(idx);
+    gen(Operation::BIN_ADD, {VR(rb), VR(rb), VR(ri)});
+    return INT(0);
+}
 void TgrEmitter::storeVar(const Operand &opr, eyr::Variable *x) {
     if (x->is_global()) {
         auto rx = allocVR();
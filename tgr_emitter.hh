@@ -12,7 +12,8 @@
 namespace mc {
 namespace tgr {
 
-class TgrEmitter {
+class TgrEmitter : public eyr::InstVisitor<TgrEmitter> {
+    friend struct eyr::InstVisitor<TgrEmitter>;
 public:
     Module *emit(eyr::Module *e_mod);
 
@@ -20,7 +21,6 @@ private:
     void runOnGlobalVar(eyr::Variable *e_var);
     void runOnFunction(eyr::Function *e_func);
     void runOnBlock(eyr::BasicBlock *e_blk);
-    void runOnInstruction(eyr::Instruction *e_inst);
 
     Module *cur_mod{nullptr};
     Function *cur_func{nullptr};
@@ -35,18 +35,19 @@ private:
     int loadOpr(eyr::Operand opr);
     int loadVar(eyr::Variable *x);
     int loadAddr(eyr::Variable *x);
+    Operand loadElemAddr(eyr::Variable *base, eyr::Operand idx, int &rb);
     void storeVar(const Operand &opr, eyr::Variable *var);
     void gen(Operation::Opt opt, std::array<Operand, 3> oprs);
 
-    void emitBinaryInst(eyr::BinaryInst *inst);
-    void emitUnaryInst(eyr::UnaryInst *inst);
-    void emitCallInst(eyr::CallInst *inst);
-    void emitMoveInst(eyr::MoveInst *inst);
-    void emitStoreInst(eyr::StoreInst *inst);
-    void emitLoadInst(eyr::LoadInst *inst);
-    void emitBranchInst(eyr::BranchInst *inst);
-    void emitJumpInst(eyr::JumpInst *inst);
-    void emitReturnInst(eyr::ReturnInst *inst);
+    void visitBinaryInst(eyr::BinaryInst *inst);
+    void visitUnaryInst(eyr::UnaryInst *inst);
+    void visitCallInst(eyr::CallInst *inst);
+    void visitMoveInst(eyr::MoveInst *inst);
+    void visitStoreInst(eyr::StoreInst *inst);
+    void visitLoadInst(eyr::LoadInst *inst);
+    void visitBranchInst(eyr::BranchInst *inst);
+    void visitJumpInst(eyr::JumpInst *inst);
+    void visitReturnInst(eyr::ReturnInst *inst);
 };
 
 };
@@ -8,6 +8,7 @@
 #include <string>
 #include <utility>
 #include <vector>
+#include "symbol.hh"
 
 namespace mc {
 
@@ -29,11 +30,12 @@ protected:
 
 struct Field {
 
-    Field(std::string s, Type *t) : id(std::move(s)), type(t) {}
+    Field(Symbol s, Type *t) : sym(s), id(symbols.name(s)), type(t) {}
 
     friend std::ostream &operator<<(std::ostream &os, const Field &f);
 
-    const std::string id;
+    const Symbol sym;
+    const std::string &id;
     Type *const type;
 };
 
@@ -38,12 +38,12 @@ V(WhileStmt) {
 }
 
 V(FuncDefn) {
-    bind(ast->get_name(), ast->get_type());
+    bind(ast->get_sym(), ast->get_type());
     CHECK();
     cur_ret_type = ast->get_ret_type();
     enter_scope();
     for (auto &f : ast->get_params()) {
-        bind(f->id, f->type);
+        bind(f->sym, f->type);
         CHECK();
     }
     for (auto s : ast->get_body()) {
@@ -70,7 +70,7 @@ V(BlockStmt) {
 }
 
 V(DeclStmt) {
-    bind(ast->get_var().id, ast->get_var().type);
+    bind(ast->get_var().sym, ast->get_var().type);
 }
 
 V(BinaryExpr) {
@@ -118,7 +118,7 @@ V(UnaryExpr) {
 }
 
 V(RefExpr) {
-    auto var_type = lookup(ast->get_name());
+    auto var_type = lookup(ast->get_sym());
     if (!var_type)
         FAIL();
     auto ref_type = var_type->indexType(ast->get_index().size());
@@ -135,7 +135,7 @@ V(RefExpr) {
 }
 
 V(CallExpr) {
-    if (auto func_type = dynamic_cast<FuncType *>(lookup(ast->get_name()))) {
+    if (auto func_type = dynamic_cast<FuncType *>(lookup(ast->get_sym()))) {
         size_t len = func_type->getParams().size();
         if (len != ast->get_args().size())
             FAIL();
@@ -154,7 +154,7 @@ V(CallExpr) {
 }
 
 V(NumExpr) {
-    ast->set_type(new IntType);
+    ast->set_type(ast_arena.make<IntType>());
 }
 bool TypeChecker::check(const std::vector<AST *> &tops) {
     check_ok = true;
@@ -171,21 +171,11 @@ bool TypeChecker::check(const std::vector<AST *> &tops) {
 
     return check_ok;
 }
-Type *TypeChecker::lookup(const std::string &id) {
-    for (auto &e : environ) {
-        auto it = e.find(id);
-        if (it != e.end())
-            return it->second;
-    }
-    return nullptr;
-}
-void TypeChecker::bind(const std::string &id, Type *type) {
-    auto &e = *environ.begin();
-    auto it = e.find(id);
-    if (it == e.end()) {
-        e[id] = type;
+void TypeChecker::bind(Symbol sym, Type *type) {
+    auto old = environ.lookupLocal(sym);
+    if (!old) {
+        environ.bind(sym, type);
     } else {
-        auto old = it->second;
         if (!dynamic_cast<FuncType *>(old))
             FAIL();
         if (*old != *type)
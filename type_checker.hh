@@ -6,10 +6,7 @@
 #define __MC_TYPE_CHECKER_HH__
 
 #include "ast.hh"
-#include <unordered_map>
-#include <map>
-#include <string>
-#include <list>
+#include "symbol.hh"
 
 namespace mc {
 
@@ -21,13 +18,13 @@ public:
     bool check(const std::vector<AST *> &tops);
 
 private:
-    Type *lookup(const std::string &id);
-    void bind(const std::string &id, Type *type);
-    inline void enter_scope() { environ.emplace_front(); }
-    inline void leave_scope() { environ.pop_front(); }
+    inline Type *lookup(Symbol sym) const { return environ.lookup(sym); }
+    void bind(Symbol sym, Type *type);
+    inline void enter_scope() { environ.enter(); }
+    inline void leave_scope() { environ.leave(); }
 
     Type *cur_ret_type;
-    std::list<std::map<std::string, Type *>> environ;
+    ScopeTable<Type *> environ;
     bool check_ok;
 };
 